@@ -0,0 +1,22 @@
+# Write the commit the executables are built from to OUTPUT as GIT_COMMIT, read by src/utils/host.h. Runs on every
+# build, but only rewrites OUTPUT when the commit or dirty flag changed, so that unchanged builds recompile nothing.
+execute_process(
+    COMMAND git describe --always --dirty
+    WORKING_DIRECTORY ${SOURCE_DIR}
+    OUTPUT_VARIABLE GIT_COMMIT
+    OUTPUT_STRIP_TRAILING_WHITESPACE
+    ERROR_QUIET)
+
+if(NOT GIT_COMMIT)
+    set(GIT_COMMIT "unknown")
+endif()
+
+set(CONTENT "#pragma once\n#define GIT_COMMIT \"${GIT_COMMIT}\"\n")
+
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} PREVIOUS)
+endif()
+
+if(NOT "${CONTENT}" STREQUAL "${PREVIOUS}")
+    file(WRITE ${OUTPUT} "${CONTENT}")
+endif()
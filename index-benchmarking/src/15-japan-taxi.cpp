@@ -1,6 +1,15 @@
 #include "experiments/geos/strtree.h"
 #include "experiments/geos/quadtree.h"
+#include "experiments/geos/forest.h"
+#include "experiments/geos/sharded.h"
+#include "experiments/geos/packedrtree.h"
+#include "experiments/geos/quantized.h"
+#include "experiments/geos/handles.h"
+#include "experiments/geos/grid.h"
 #include "experiments/s2/pointindex.h"
+#include "experiments/s2/sharded.h"
+#include "experiments/s2/cellarray.h"
+#include "experiments/s2/learnedindex.h"
 
 int main(int argc, char **argv)
 {
@@ -27,23 +36,92 @@ int main(int argc, char **argv)
     const std::vector<std::string> fixed_distance_query_file = {distance_query_files[3]};
     const std::vector<std::string> fixed_range_query_file = {range_query_files[3]};
 
-    auto strtree_runner = STRtreeExperimentRunner("15__geos_strtree", "EPSG:6677", argv[0]);
-    strtree_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file);
-    strtree_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file);
-    strtree_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file);
-    strtree_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files);
-
-    auto quadtree_runner = QuadtreeExperimentRunner("15__geos_quadtree", "EPSG:6677", argv[0]);
-    quadtree_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file);
-    quadtree_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file);
-    quadtree_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file);
-    quadtree_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files);
-
-    auto s2pointindex_runner = S2PointIndexExperimentRunner("15__s2_pointindex", argv[0]);
-    s2pointindex_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file);
-    s2pointindex_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file);
-    s2pointindex_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file);
-    s2pointindex_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files);
+    // kNN queries use the query points of a distance query file.
+    const std::vector<std::string> knn_query_files = {distance_query_files[3]};
+
+    auto strtree_runner = STRtreeExperimentRunner("15__geos_strtree", "EPSG:6677");
+    strtree_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    strtree_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    strtree_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    strtree_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto parallel_strtree_runner = ParallelSTRtreeExperimentRunner("15__geos_strtree_parallel", "EPSG:6677");
+    parallel_strtree_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    parallel_strtree_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    parallel_strtree_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    parallel_strtree_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto sharded_strtree_runner = ShardedSTRtreeExperimentRunner("15__geos_strtree_sharded", "EPSG:6677");
+    sharded_strtree_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    sharded_strtree_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    sharded_strtree_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    sharded_strtree_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto strtree_handle_runner = STRtreeHandleExperimentRunner("15__geos_strtree_handles", "EPSG:6677");
+    strtree_handle_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    strtree_handle_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    strtree_handle_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    strtree_handle_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto packedrtree_runner = PackedRTreeExperimentRunner("15__packed_rtree", "EPSG:6677");
+    packedrtree_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    packedrtree_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    packedrtree_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    packedrtree_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto quantizedrtree_runner = QuantizedRTreeExperimentRunner("15__quantized_rtree", "EPSG:6677");
+    quantizedrtree_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    quantizedrtree_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    quantizedrtree_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    quantizedrtree_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto grid_runner = GridExperimentRunner("15__grid", "EPSG:6677");
+    grid_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    grid_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    grid_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    grid_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto quadtree_runner = QuadtreeExperimentRunner("15__geos_quadtree", "EPSG:6677");
+    quadtree_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    quadtree_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    quadtree_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    quadtree_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto parallel_quadtree_runner = ParallelQuadtreeExperimentRunner("15__geos_quadtree_parallel", "EPSG:6677");
+    parallel_quadtree_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    parallel_quadtree_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    parallel_quadtree_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    parallel_quadtree_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto quadtree_handle_runner = QuadtreeHandleExperimentRunner("15__geos_quadtree_handles", "EPSG:6677");
+    quadtree_handle_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    quadtree_handle_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    quadtree_handle_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    quadtree_handle_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2pointindex_runner = S2PointIndexExperimentRunner("15__s2_pointindex");
+    s2pointindex_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    s2pointindex_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    s2pointindex_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    s2pointindex_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto sharded_s2pointindex_runner = ShardedS2PointIndexExperimentRunner("15__s2_pointindex_sharded");
+    sharded_s2pointindex_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    sharded_s2pointindex_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    sharded_s2pointindex_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    sharded_s2pointindex_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2cellarray_runner = S2CellArrayExperimentRunner("15__s2_cellarray");
+    s2cellarray_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    s2cellarray_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    s2cellarray_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    s2cellarray_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2learned_runner = LearnedIndexExperimentRunner("15__s2_learned");
+    s2learned_runner.run("japan-taxi-0_25m", data_file_0_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    s2learned_runner.run("japan-taxi-2_5m", data_file_2_5m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    s2learned_runner.run("japan-taxi-25m", data_file_25m, fixed_distance_query_file, fixed_range_query_file, knn_query_files);
+    s2learned_runner.run("japan-taxi-250m", data_file_250m, distance_query_files, range_query_files, knn_query_files);
 
     return 0;
 }
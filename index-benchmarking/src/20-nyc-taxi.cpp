@@ -1,6 +1,12 @@
 #include "experiments/geos/strtree.h"
 #include "experiments/geos/quadtree.h"
+#include "experiments/geos/handles.h"
+#include "experiments/geos/packedrtree.h"
+#include "experiments/geos/grid.h"
+#include "experiments/geos/lsm.h"
 #include "experiments/s2/pointindex.h"
+#include "experiments/s2/cellarray.h"
+#include "experiments/s2/learnedindex.h"
 
 int main(int argc, char **argv)
 {
@@ -13,14 +19,75 @@ int main(int argc, char **argv)
         "../data/taxi/nyc-taxi/queries/taxi_range_0.1.csv",
     };
 
-    auto strtree_runner = STRtreeExperimentRunner("20__geos_strtree", "EPSG:32118", argv[0]);
-    strtree_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files);
+    // kNN queries use the query points of the distance query file.
+    const std::vector<std::string> knn_query_files = {distance_query_files[0]};
 
-    auto quadtree_runner = QuadtreeExperimentRunner("20__geos_quadtree", "EPSG:32118", argv[0]);
-    quadtree_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files);
+    // Taxis moving, starting and ending trips in between queries, for the indexes that can be updated.
+    MixedWorkload moving_taxis;
+    moving_taxis.inserts = 1;
+    moving_taxis.removes = 1;
+    moving_taxis.moves = 4;
+    moving_taxis.knn_queries = 1;
 
-    auto s2pointindex_runner = S2PointIndexExperimentRunner("20__s2_pointindex", argv[0]);
-    s2pointindex_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files);
+    auto strtree_runner = STRtreeExperimentRunner("20__geos_strtree", "EPSG:32118");
+    strtree_runner.set_query_threads(thread_sweep(hardware_threads()));
+    strtree_runner.set_query_batch_sizes({64, 1024, 16384});
+    strtree_runner.set_mixed_workload(moving_taxis);
+    strtree_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
+
+    auto strtree_handle_runner = STRtreeHandleExperimentRunner("20__geos_strtree_handles", "EPSG:32118");
+    strtree_handle_runner.set_query_threads(thread_sweep(hardware_threads()));
+    strtree_handle_runner.set_query_batch_sizes({64, 1024, 16384});
+    strtree_handle_runner.set_mixed_workload(moving_taxis);
+    strtree_handle_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
+
+    auto packedrtree_runner = PackedRTreeExperimentRunner("20__packed_rtree", "EPSG:32118");
+    packedrtree_runner.set_query_threads(thread_sweep(hardware_threads()));
+    packedrtree_runner.set_query_batch_sizes({64, 1024, 16384});
+    packedrtree_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
+
+    auto hilbertrtree_runner = PackedRTreeExperimentRunner("20__packed_rtree_hilbert", "EPSG:32118", PackedRTree::HILBERT);
+    hilbertrtree_runner.set_query_threads(thread_sweep(hardware_threads()));
+    hilbertrtree_runner.set_query_batch_sizes({64, 1024, 16384});
+    hilbertrtree_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
+
+    auto grid_runner = GridExperimentRunner("20__grid", "EPSG:32118");
+    grid_runner.set_query_threads(thread_sweep(hardware_threads()));
+    grid_runner.set_query_batch_sizes({64, 1024, 16384});
+    grid_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
+
+    auto uniformgrid_runner = GridExperimentRunner("20__grid_uniform", "EPSG:32118", false);
+    uniformgrid_runner.set_query_threads(thread_sweep(hardware_threads()));
+    uniformgrid_runner.set_query_batch_sizes({64, 1024, 16384});
+    uniformgrid_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
+
+    auto quadtree_runner = QuadtreeExperimentRunner("20__geos_quadtree", "EPSG:32118");
+    quadtree_runner.set_query_threads(thread_sweep(hardware_threads()));
+    quadtree_runner.set_query_batch_sizes({64, 1024, 16384});
+    quadtree_runner.set_mixed_workload(moving_taxis);
+    quadtree_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
+
+    auto lsm_runner = LsmExperimentRunner("20__lsm_rtree", "EPSG:32118");
+    lsm_runner.set_query_threads(thread_sweep(hardware_threads()));
+    lsm_runner.set_query_batch_sizes({64, 1024, 16384});
+    lsm_runner.set_mixed_workload(moving_taxis);
+    lsm_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2pointindex_runner = S2PointIndexExperimentRunner("20__s2_pointindex");
+    s2pointindex_runner.set_query_threads(thread_sweep(hardware_threads()));
+    s2pointindex_runner.set_query_batch_sizes({64, 1024, 16384});
+    s2pointindex_runner.set_mixed_workload(moving_taxis);
+    s2pointindex_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2cellarray_runner = S2CellArrayExperimentRunner("20__s2_cellarray");
+    s2cellarray_runner.set_query_threads(thread_sweep(hardware_threads()));
+    s2cellarray_runner.set_query_batch_sizes({64, 1024, 16384});
+    s2cellarray_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2learned_runner = LearnedIndexExperimentRunner("20__s2_learned");
+    s2learned_runner.set_query_threads(thread_sweep(hardware_threads()));
+    s2learned_runner.set_query_batch_sizes({64, 1024, 16384});
+    s2learned_runner.run("nyc-taxi-10m", data_file_10m, distance_query_files, range_query_files, knn_query_files);
 
     return 0;
 }
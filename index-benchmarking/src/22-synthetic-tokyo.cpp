@@ -1,6 +1,10 @@
 #include "experiments/geos/strtree.h"
 #include "experiments/geos/quadtree.h"
+#include "experiments/geos/packedrtree.h"
+#include "experiments/geos/grid.h"
 #include "experiments/s2/pointindex.h"
+#include "experiments/s2/cellarray.h"
+#include "experiments/s2/learnedindex.h"
 
 int main(int argc, char **argv)
 {
@@ -13,14 +17,32 @@ int main(int argc, char **argv)
         "../data/synthetic/tokyo/queries/synthetic_range_0.1.csv",
     };
 
-    auto strtree_runner = STRtreeExperimentRunner("22__geos_strtree", "EPSG:6677", argv[0]);
-    strtree_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files);
+    // kNN queries use the query points of the distance query file.
+    const std::vector<std::string> knn_query_files = {distance_query_files[0]};
 
-    auto quadtree_runner = QuadtreeExperimentRunner("22__geos_quadtree", "EPSG:6677", argv[0]);
-    quadtree_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files);
+    auto strtree_runner = STRtreeExperimentRunner("22__geos_strtree", "EPSG:6677");
+    strtree_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
 
-    auto s2pointindex_runner = S2PointIndexExperimentRunner("22__s2_pointindex", argv[0]);
-    s2pointindex_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files);
+    auto packedrtree_runner = PackedRTreeExperimentRunner("22__packed_rtree", "EPSG:6677");
+    packedrtree_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto grid_runner = GridExperimentRunner("22__grid", "EPSG:6677");
+    grid_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto uniformgrid_runner = GridExperimentRunner("22__grid_uniform", "EPSG:6677", false);
+    uniformgrid_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto quadtree_runner = QuadtreeExperimentRunner("22__geos_quadtree", "EPSG:6677");
+    quadtree_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2pointindex_runner = S2PointIndexExperimentRunner("22__s2_pointindex");
+    s2pointindex_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2cellarray_runner = S2CellArrayExperimentRunner("22__s2_cellarray");
+    s2cellarray_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2learned_runner = LearnedIndexExperimentRunner("22__s2_learned");
+    s2learned_runner.run("synthetic-tokyo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
 
     return 0;
 }
@@ -1,6 +1,10 @@
 #include "experiments/geos/strtree.h"
 #include "experiments/geos/quadtree.h"
+#include "experiments/geos/packedrtree.h"
+#include "experiments/geos/grid.h"
 #include "experiments/s2/pointindex.h"
+#include "experiments/s2/cellarray.h"
+#include "experiments/s2/learnedindex.h"
 
 int main(int argc, char **argv)
 {
@@ -13,14 +17,32 @@ int main(int argc, char **argv)
         "../data/synthetic/delhi/queries/synthetic_range_0.1.csv",
     };
 
-    auto strtree_runner = STRtreeExperimentRunner("23__geos_strtree", "EPSG:24378", argv[0]);
-    strtree_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files);
+    // kNN queries use the query points of the distance query file.
+    const std::vector<std::string> knn_query_files = {distance_query_files[0]};
 
-    auto quadtree_runner = QuadtreeExperimentRunner("23__geos_quadtree", "EPSG:24378", argv[0]);
-    quadtree_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files);
+    auto strtree_runner = STRtreeExperimentRunner("23__geos_strtree", "EPSG:24378");
+    strtree_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files, knn_query_files);
 
-    auto s2pointindex_runner = S2PointIndexExperimentRunner("23__s2_pointindex", argv[0]);
-    s2pointindex_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files);
+    auto packedrtree_runner = PackedRTreeExperimentRunner("23__packed_rtree", "EPSG:24378");
+    packedrtree_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto grid_runner = GridExperimentRunner("23__grid", "EPSG:24378");
+    grid_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto uniformgrid_runner = GridExperimentRunner("23__grid_uniform", "EPSG:24378", false);
+    uniformgrid_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto quadtree_runner = QuadtreeExperimentRunner("23__geos_quadtree", "EPSG:24378");
+    quadtree_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2pointindex_runner = S2PointIndexExperimentRunner("23__s2_pointindex");
+    s2pointindex_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2cellarray_runner = S2CellArrayExperimentRunner("23__s2_cellarray");
+    s2cellarray_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2learned_runner = LearnedIndexExperimentRunner("23__s2_learned");
+    s2learned_runner.run("synthetic-delhi-10m", data_file, distance_query_files, range_query_files, knn_query_files);
 
     return 0;
 }
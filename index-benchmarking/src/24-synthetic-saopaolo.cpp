@@ -1,6 +1,10 @@
 #include "experiments/geos/strtree.h"
 #include "experiments/geos/quadtree.h"
+#include "experiments/geos/packedrtree.h"
+#include "experiments/geos/grid.h"
 #include "experiments/s2/pointindex.h"
+#include "experiments/s2/cellarray.h"
+#include "experiments/s2/learnedindex.h"
 
 int main(int argc, char **argv)
 {
@@ -13,14 +17,32 @@ int main(int argc, char **argv)
         "../data/synthetic/saopaolo/queries/synthetic_range_0.1.csv",
     };
 
-    auto strtree_runner = STRtreeExperimentRunner("24__geos_strtree", "EPSG:29101", argv[0]);
-    strtree_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files);
+    // kNN queries use the query points of the distance query file.
+    const std::vector<std::string> knn_query_files = {distance_query_files[0]};
 
-    auto quadtree_runner = QuadtreeExperimentRunner("24__geos_quadtree", "EPSG:29101", argv[0]);
-    quadtree_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files);
+    auto strtree_runner = STRtreeExperimentRunner("24__geos_strtree", "EPSG:29101");
+    strtree_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
 
-    auto s2pointindex_runner = S2PointIndexExperimentRunner("24__s2_pointindex", argv[0]);
-    s2pointindex_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files);
+    auto packedrtree_runner = PackedRTreeExperimentRunner("24__packed_rtree", "EPSG:29101");
+    packedrtree_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto grid_runner = GridExperimentRunner("24__grid", "EPSG:29101");
+    grid_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto uniformgrid_runner = GridExperimentRunner("24__grid_uniform", "EPSG:29101", false);
+    uniformgrid_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto quadtree_runner = QuadtreeExperimentRunner("24__geos_quadtree", "EPSG:29101");
+    quadtree_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2pointindex_runner = S2PointIndexExperimentRunner("24__s2_pointindex");
+    s2pointindex_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2cellarray_runner = S2CellArrayExperimentRunner("24__s2_cellarray");
+    s2cellarray_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
+
+    auto s2learned_runner = LearnedIndexExperimentRunner("24__s2_learned");
+    s2learned_runner.run("synthetic-saopaolo-10m", data_file, distance_query_files, range_query_files, knn_query_files);
 
     return 0;
 }
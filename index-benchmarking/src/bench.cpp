@@ -0,0 +1,162 @@
+#include "utils/config.h"
+#include "experiments/geos/strtree.h"
+#include "experiments/geos/quadtree.h"
+#include "experiments/geos/forest.h"
+#include "experiments/geos/sharded.h"
+#include "experiments/geos/packedrtree.h"
+#include "experiments/geos/quantized.h"
+#include "experiments/geos/handles.h"
+#include "experiments/geos/grid.h"
+#include "experiments/geos/lsm.h"
+#include "experiments/s2/pointindex.h"
+#include "experiments/s2/sharded.h"
+#include "experiments/s2/cellarray.h"
+#include "experiments/s2/learnedindex.h"
+
+// Benchmark driver for a configuration file instead of hard-coded paths. Every [section] is one benchmark: a data set
+// with its query files, run on each of the listed runners, for example
+//
+//   measurement = fixed_work
+//   repetitions = 5
+//
+//   [nyc-taxi-10m]
+//   geometry = ../data/taxi/nyc-taxi/nyc-taxi-10m.bin
+//   crs = EPSG:32118
+//   distance_queries = ../data/taxi/nyc-taxi/queries/taxi_distance_0.1.csv
+//   range_queries = ../data/taxi/nyc-taxi/queries/taxi_range_0.1.csv
+//   runners = geos_strtree, packed_rtree, s2_pointindex
+//
+// Keys before the first section apply to every section. Reports are written to
+// results/<name>__<runner>_<section>.txt.
+
+static const std::set<std::string> &config_keys()
+{
+    static const std::set<std::string> keys = {
+        "name", "geometry", "crs", "distance_queries", "range_queries", "knn_queries", "runners",
+        "query_threads", "knn_k", "batch_sizes", "snapshot_directory", "profile_directory",
+        "measurement", "max_seconds", "warmup_passes", "repetitions",
+        "mixed_weights", "mixed_operations"};
+
+    return keys;
+}
+
+template <typename TRunner>
+void run_benchmark(TRunner runner, const ConfigSection &config)
+{
+    // "sweep" runs 1, 2, 4, ... threads up to the number of hardware threads.
+    if (config.get("query_threads", "") == "sweep")
+    {
+        runner.set_query_threads(thread_sweep(hardware_threads()));
+    }
+    else
+    {
+        runner.set_query_threads(config.numbers<unsigned int>("query_threads", {1}));
+    }
+
+    runner.set_knn_k(config.numbers<size_t>("knn_k", {1, 10, 100}));
+    runner.set_query_batch_sizes(config.numbers<size_t>("batch_sizes", {}));
+    runner.set_snapshot_directory(config.get("snapshot_directory", ""));
+    runner.set_profile_directory(config.get("profile_directory", ""));
+
+    Measurement measurement;
+    std::string mode = config.get("measurement", "fixed_time");
+
+    if (mode != "fixed_time" && mode != "fixed_work")
+    {
+        throw std::runtime_error("Measurement <" + mode + "> of section [" + config.name() + "] is neither fixed_time nor fixed_work.");
+    }
+
+    measurement.mode = mode == "fixed_work" ? Measurement::FIXED_WORK : Measurement::FIXED_TIME;
+    measurement.max_seconds = config.number("max_seconds", measurement.max_seconds);
+    measurement.warmup_passes = config.number("warmup_passes", measurement.warmup_passes);
+    measurement.repetitions = config.number("repetitions", measurement.repetitions);
+    runner.set_measurement(measurement);
+
+    // Weights of distance queries, range queries, inserts, removes, moves and optionally kNN queries, which use the
+    // first k of knn_k (10 if it is not set).
+    if (config.has("mixed_weights"))
+    {
+        auto weights = config.numbers<double>("mixed_weights", {});
+
+        if (weights.size() != 5 && weights.size() != 6)
+        {
+            throw std::runtime_error("Key <mixed_weights> of section [" + config.name() + "] needs 5 or 6 weights.");
+        }
+
+        MixedWorkload mix;
+        mix.distance_queries = weights[0];
+        mix.range_queries = weights[1];
+        mix.inserts = weights[2];
+        mix.removes = weights[3];
+        mix.moves = weights[4];
+        mix.knn_queries = weights.size() == 6 ? weights[5] : 0;
+        auto knn_k = config.numbers<size_t>("knn_k", {mix.knn_k});
+        mix.knn_k = knn_k.empty() ? mix.knn_k : knn_k.front();
+        mix.n_operations = config.number("mixed_operations", mix.n_operations);
+        runner.set_mixed_workload(mix);
+    }
+
+    runner.run(config.name(), config.get("geometry"), config.list("distance_queries"), config.list("range_queries"), config.list("knn_queries"));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <config file>" << std::endl;
+        return 1;
+    }
+
+    // Runner names, as used in the report names of the experiment mains.
+    std::map<std::string, std::function<void(std::string, const ConfigSection &)>> runners = {
+        {"geos_strtree", [&](std::string name, const ConfigSection &config) { run_benchmark(STRtreeExperimentRunner(name, config.get("crs")), config); }},
+        {"geos_strtree_parallel", [&](std::string name, const ConfigSection &config) { run_benchmark(ParallelSTRtreeExperimentRunner(name, config.get("crs")), config); }},
+        {"geos_strtree_sharded", [&](std::string name, const ConfigSection &config) { run_benchmark(ShardedSTRtreeExperimentRunner(name, config.get("crs")), config); }},
+        {"geos_strtree_handles", [&](std::string name, const ConfigSection &config) { run_benchmark(STRtreeHandleExperimentRunner(name, config.get("crs")), config); }},
+        {"geos_quadtree", [&](std::string name, const ConfigSection &config) { run_benchmark(QuadtreeExperimentRunner(name, config.get("crs")), config); }},
+        {"geos_quadtree_parallel", [&](std::string name, const ConfigSection &config) { run_benchmark(ParallelQuadtreeExperimentRunner(name, config.get("crs")), config); }},
+        {"geos_quadtree_handles", [&](std::string name, const ConfigSection &config) { run_benchmark(QuadtreeHandleExperimentRunner(name, config.get("crs")), config); }},
+        {"packed_rtree", [&](std::string name, const ConfigSection &config) { run_benchmark(PackedRTreeExperimentRunner(name, config.get("crs")), config); }},
+        {"packed_rtree_hilbert", [&](std::string name, const ConfigSection &config) { run_benchmark(PackedRTreeExperimentRunner(name, config.get("crs"), PackedRTree::HILBERT), config); }},
+        {"quantized_rtree", [&](std::string name, const ConfigSection &config) { run_benchmark(QuantizedRTreeExperimentRunner(name, config.get("crs")), config); }},
+        {"grid", [&](std::string name, const ConfigSection &config) { run_benchmark(GridExperimentRunner(name, config.get("crs")), config); }},
+        {"grid_uniform", [&](std::string name, const ConfigSection &config) { run_benchmark(GridExperimentRunner(name, config.get("crs"), false), config); }},
+        {"lsm_rtree", [&](std::string name, const ConfigSection &config) { run_benchmark(LsmExperimentRunner(name, config.get("crs")), config); }},
+        {"s2_pointindex", [&](std::string name, const ConfigSection &config) { run_benchmark(S2PointIndexExperimentRunner(name), config); }},
+        {"s2_pointindex_sharded", [&](std::string name, const ConfigSection &config) { run_benchmark(ShardedS2PointIndexExperimentRunner(name), config); }},
+        {"s2_cellarray", [&](std::string name, const ConfigSection &config) { run_benchmark(S2CellArrayExperimentRunner(name), config); }},
+        {"s2_learned", [&](std::string name, const ConfigSection &config) { run_benchmark(LearnedIndexExperimentRunner(name), config); }},
+    };
+
+    ConfigFile config_file(argv[1]);
+
+    // Check the whole file up front, so that a typo does not surface hours into a run.
+    for (const auto &config : config_file.sections())
+    {
+        config.check_keys(config_keys());
+        config.get("geometry");
+
+        if (config.list("runners").empty())
+        {
+            throw std::runtime_error("Section [" + config.name() + "] lists no runners.");
+        }
+
+        for (const auto &runner : config.list("runners"))
+        {
+            if (runners.count(runner) == 0)
+            {
+                throw std::runtime_error("Unknown runner <" + runner + "> in section [" + config.name() + "].");
+            }
+        }
+    }
+
+    for (const auto &config : config_file.sections())
+    {
+        for (const auto &runner : config.list("runners"))
+        {
+            runners.at(runner)(config.get("name", "bench") + "__" + runner, config);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include <map>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <dirent.h>
+#include "utils/csv.h"
+#include "utils/stats.h"
+
+// Compare two sets of result records (results/*.csv) and flag regressions of the candidate against the baseline.
+// A throughput change counts if it exceeds the minimum relative change and, when both sides have at least two
+// repetitions, Welch's t-test finds it significant at the 95% level. Changes of runs with a single repetition cannot
+// be tested and are only listed as unconfirmed. Index sizes are deterministic, so they only need the minimum change.
+// Exits with 1 if the candidate has any regression, so it can gate a change.
+
+struct Record
+{
+    double throughput;
+    double throughput_ci;
+    unsigned int repetitions;
+    double index_size;
+};
+
+// Records by measurement: run, workload, query file, k, thread count and batch size.
+typedef std::map<std::string, Record> RecordSet;
+
+static void load_file(std::string file_path, RecordSet &records)
+{
+    std::ifstream file(file_path);
+    std::string line;
+
+    if (!std::getline(file, line))
+    {
+        return;
+    }
+
+    std::map<std::string, size_t> columns;
+    auto header = csv_split(line);
+
+    for (size_t i = 0; i < header.size(); i++)
+    {
+        columns[header[i]] = i;
+    }
+
+    for (const auto &column : {"run_name", "workload", "query_file", "k", "query_threads", "batch_size", "throughput", "throughput_ci95", "repetitions", "index_size_mb"})
+    {
+        if (columns.count(column) == 0)
+        {
+            throw std::runtime_error("<" + file_path + "> has no column <" + column + ">.");
+        }
+    }
+
+    while (std::getline(file, line))
+    {
+        auto fields = csv_split(line);
+
+        if (fields.size() != header.size())
+        {
+            continue;
+        }
+
+        auto field = [&](std::string column) { return fields[columns[column]]; };
+        std::string key = field("run_name") + " " + field("workload") + " " + field("query_file") + " k=" + field("k") + " threads=" + field("query_threads") + " batch=" + field("batch_size");
+
+        records[key] = {std::stod(field("throughput")), std::stod(field("throughput_ci95")), (unsigned int)std::stoul(field("repetitions")), std::stod(field("index_size_mb"))};
+    }
+}
+
+// Load a single record file, or every record file in a directory.
+static RecordSet load_records(std::string path)
+{
+    RecordSet records;
+    DIR *directory = opendir(path.c_str());
+
+    if (directory == nullptr)
+    {
+        std::ifstream file(path);
+
+        if (!file)
+        {
+            throw std::runtime_error("Could not open <" + path + ">.");
+        }
+
+        load_file(path, records);
+        return records;
+    }
+
+    while (auto entry = readdir(directory))
+    {
+        std::string name = entry->d_name;
+
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".csv") == 0)
+        {
+            load_file(path + "/" + name, records);
+        }
+    }
+
+    closedir(directory);
+    return records;
+}
+
+// Standard error of the mean, recovered from the half-width of the 95% confidence interval.
+static double standard_error(const Record &record)
+{
+    return record.throughput_ci / student_t95(record.repetitions - 1);
+}
+
+// Welch's t-test on the throughput of both records, which need at least two repetitions each.
+static bool significant(const Record &baseline, const Record &candidate)
+{
+    double v1 = std::pow(standard_error(baseline), 2);
+    double v2 = std::pow(standard_error(candidate), 2);
+
+    if (v1 + v2 == 0)
+    {
+        return baseline.throughput != candidate.throughput;
+    }
+
+    double t = std::abs(candidate.throughput - baseline.throughput) / std::sqrt(v1 + v2);
+    double df = std::pow(v1 + v2, 2) / (v1 * v1 / (baseline.repetitions - 1) + v2 * v2 / (candidate.repetitions - 1));
+
+    return t > student_t95((size_t)std::max(1.0, std::floor(df)));
+}
+
+static std::string percent(double change)
+{
+    std::stringstream ss;
+    ss << std::showpos << std::fixed << std::setprecision(1) << 100 * change << "%";
+    return ss.str();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3 && argc != 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <baseline results> <candidate results> [minimum relative change, default 0.05]" << std::endl;
+        return 2;
+    }
+
+    auto baseline = load_records(argv[1]);
+    auto candidate = load_records(argv[2]);
+    double min_change = argc == 4 ? std::stod(argv[3]) : 0.05;
+
+    size_t compared = 0;
+    size_t regressions = 0;
+    size_t improvements = 0;
+    size_t unconfirmed = 0;
+    std::map<std::string, std::pair<double, double>> index_sizes;
+
+    for (const auto &entry : candidate)
+    {
+        if (baseline.count(entry.first) == 0)
+        {
+            continue;
+        }
+
+        const auto &before = baseline.at(entry.first);
+        const auto &after = entry.second;
+        compared++;
+
+        index_sizes[entry.first.substr(0, entry.first.find(' '))] = {before.index_size, after.index_size};
+
+        double change = before.throughput > 0 ? after.throughput / before.throughput - 1 : 0;
+
+        if (std::abs(change) < min_change)
+        {
+            continue;
+        }
+
+        std::string verdict;
+
+        if (before.repetitions < 2 || after.repetitions < 2)
+        {
+            verdict = "unconfirmed";
+            unconfirmed++;
+        }
+        else if (!significant(before, after))
+        {
+            continue;
+        }
+        else if (change < 0)
+        {
+            verdict = "REGRESSION ";
+            regressions++;
+        }
+        else
+        {
+            verdict = "improvement";
+            improvements++;
+        }
+
+        std::cout << verdict << " | " << entry.first << " | " << before.throughput << " -> " << after.throughput << " queries/s (" << percent(change) << ")" << std::endl;
+    }
+
+    for (const auto &size : index_sizes)
+    {
+        double change = size.second.first > 0 ? size.second.second / size.second.first - 1 : 0;
+
+        if (change > min_change)
+        {
+            std::cout << "REGRESSION  | " << size.first << " index size | " << size.second.first << " -> " << size.second.second << " MB (" << percent(change) << ")" << std::endl;
+            regressions++;
+        }
+    }
+
+    std::cout << "Compared " << compared << " measurements: " << regressions << " regression(s), " << improvements << " improvement(s), " << unconfirmed << " unconfirmed change(s)." << std::endl;
+
+    return regressions > 0 ? 1 : 0;
+}
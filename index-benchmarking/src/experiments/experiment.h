@@ -3,12 +3,22 @@
 #include <future>
 #include <thread>
 #include <atomic>
-#include <gperftools/heap-profiler.h>
+#include <numeric>
+#include <random>
+#include <iomanip>
 #include <s2/s2point_index.h>
 #include <s2/s2point.h>
 #include "../utils/progress.h"
 #include "../utils/data.h"
-#include "../utils/exec.h"
+#include "../utils/memory.h"
+#include "../utils/parallel.h"
+#include "../utils/histogram.h"
+#include "../utils/mmap.h"
+#include "../utils/stats.h"
+#include "../utils/perf.h"
+#include "../utils/profile.h"
+#include "../utils/csv.h"
+#include "../utils/host.h"
 
 template <typename TPoint>
 struct DistanceQuery
@@ -23,25 +33,748 @@ struct RangeQuery
     TRect range;
 };
 
-template <typename TIndex, typename TGeom, typename TDQuery, typename TRQuery>
+template <typename TPoint>
+struct KnnQuery
+{
+    TPoint point;
+};
+
+// Contiguous part of a query workload. Executors only see a slice, so the workload can be split across threads.
+// An optional order replays the queries permuted: element i is query order[i] of the workload.
+template <typename TQuery>
+class QuerySlice
+{
+private:
+    TQuery *_queries;
+    const uint32_t *_order;
+    size_t _offset;
+    size_t _size;
+
+public:
+    QuerySlice(TQuery *queries, size_t size, const uint32_t *order = nullptr, size_t offset = 0) : _queries(queries), _order(order), _offset(offset), _size(size){};
+    QuerySlice(std::vector<TQuery> &queries) : _queries(queries.data()), _order(nullptr), _offset(0), _size(queries.size()){};
+
+    inline TQuery &operator[](size_t i) const
+    {
+        return _queries[position(i)];
+    }
+
+    // Position of element i in the workload, i.e. where its result belongs.
+    inline size_t position(size_t i) const
+    {
+        return _order ? _order[_offset + i] : _offset + i;
+    }
+
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+    QuerySlice slice(size_t offset, size_t count) const
+    {
+        return QuerySlice(_queries, count, _order, _offset + offset);
+    }
+};
+
+// Thread counts 1, 2, 4, ... up to and including max_threads.
+std::vector<unsigned int> thread_sweep(unsigned int max_threads)
+{
+    std::vector<unsigned int> thread_counts;
+
+    for (unsigned int t = 1; t < max_threads; t *= 2)
+    {
+        thread_counts.push_back(t);
+    }
+
+    thread_counts.push_back(std::max(1u, max_threads));
+    return thread_counts;
+}
+
+// How query workloads are measured. Every measured configuration runs warmup_passes unrecorded passes over the query
+// file and then repetitions recorded ones. In FIXED_TIME mode a pass stops after max_seconds, so slow indexes only
+// execute a prefix of the file; in FIXED_WORK mode every pass executes every query, however long that takes.
+struct Measurement
+{
+    enum Mode
+    {
+        FIXED_TIME,
+        FIXED_WORK,
+    };
+
+    Mode mode = FIXED_TIME;
+    double max_seconds = 2 * 60;
+    unsigned int warmup_passes = 0;
+    unsigned int repetitions = 1;
+};
+
+// Outcome of executing one query file at a given thread count: the mean throughput over the repetitions with the
+// half-width of its 95% confidence interval, the latencies of all repetitions and the queries executed per pass.
+struct QueryRunResult
+{
+    float throughput;
+    float throughput_ci;
+    LatencyHistogram latencies;
+    size_t executed;
+    size_t total_executed; // over all passes, warmup included
+};
+
+// Outcome of one query workload: throughput on every thread count, latencies and executed queries on the first
+// thread count and throughput on every batch size (first thread count).
+struct WorkloadResult
+{
+    std::vector<float> throughputs;
+    std::vector<float> throughput_cis;
+    LatencyHistogram latencies;
+    size_t executed = 0;
+    size_t n_queries = 0;
+    std::vector<float> batched_throughputs;
+    size_t total_executed = 0; // over every run of the workload, to normalize its hardware counters
+    std::vector<QueryRunResult> runs; // every thread count, then every batch size, for the result records
+};
+
+// One change to the indexed points. Inserts and moves place point id at the position of point anchor, offset by
+// (dx, dy) meters; a move is anchored on the point itself.
+struct PointUpdate
+{
+    enum Kind
+    {
+        INSERT,
+        REMOVE,
+        MOVE,
+    };
+
+    Kind kind;
+    uint32_t id;
+    uint32_t anchor;
+    double dx;
+    double dy;
+};
+
+// Operation mix of a workload that interleaves updates with queries. The weights are relative frequencies.
+struct MixedWorkload
+{
+    double distance_queries = 1;
+    double range_queries = 1;
+    double inserts = 0;
+    double removes = 0;
+    double moves = 2;
+    double knn_queries = 0;
+    size_t knn_k = 10;
+    size_t n_operations = 100000;
+    double max_step = 50; // largest offset of an insert or move along either axis, in meters
+};
+
+// Outcome of a mixed workload. Query latencies are those observed while the index was being updated.
+struct MixedResult
+{
+    size_t operations = 0;
+    size_t updates = 0;
+    double seconds = 0;
+    LatencyHistogram update_latencies;
+    WorkloadResult dquery;
+    WorkloadResult rquery;
+    WorkloadResult kquery;
+};
+
+template <typename TIndex, typename TGeom, typename TDQuery, typename TRQuery, typename TKQuery>
 class BaseExperimentRunner
 {
 private:
+    // Queries a thread executes between two checks of the time limit.
+    enum
+    {
+        QUERY_CHUNK_SIZE = 256,
+    };
+
     const std::string _name;
-    const std::string _executable_name;
+    std::vector<unsigned int> _query_threads = {1};
+    std::vector<size_t> _knn_k = {1, 10, 100};
+    std::vector<size_t> _batch_sizes;
+    std::string _snapshot_directory;
+    std::string _profile_directory;
+    bool _run_mixed = false;
+    MixedWorkload _mixed_workload;
+    Measurement _measurement;
+
+    template <typename T>
+    static void write_list(std::ostream &out, const std::vector<T> &values)
+    {
+        out << "[";
+
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            out << (i == 0 ? "" : ", ") << values[i];
+        }
+
+        out << "]";
+    }
+
+    // Split the queries into one contiguous slice per thread and execute the slices concurrently against the
+    // shared index. Every thread records latencies into its own histogram, which are merged afterwards. Threads
+    // execute their slice in chunks of chunk_size queries and stop at the first chunk boundary after max_seconds, if
+    // positive. The clock is only read once per chunk and progress is counted
+    // per thread, so the per-query overhead is the latency measurement itself.
+    template <typename TQuery, typename TExecute>
+    static QueryRunResult execute_concurrent(std::vector<TQuery> &queries, size_t chunk_size, unsigned int n_threads, double max_seconds, TExecute execute)
+    {
+        std::vector<LatencyHistogram> latencies(std::max(1u, n_threads));
+        ProgressTracker pt;
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        parallel_for(queries.size(), n_threads, [&](size_t begin, size_t end, unsigned int thread_id) {
+            auto slice = QuerySlice<TQuery>(queries).slice(begin, end - begin);
+            auto progress = pt.counter(queries.size());
+
+            for (size_t offset = 0; offset < slice.size(); offset += chunk_size)
+            {
+                if (max_seconds > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() >= max_seconds)
+                {
+                    break;
+                }
+
+                execute(slice.slice(offset, std::min<size_t>(chunk_size, slice.size() - offset)), latencies[thread_id], progress);
+            }
+        });
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        pt.stop();
+
+        QueryRunResult result;
+
+        for (const auto &histogram : latencies)
+        {
+            result.latencies.merge(histogram);
+        }
+
+        // Every executed query records one latency.
+        result.executed = result.latencies.count();
+        result.total_executed = result.executed;
+        result.throughput = seconds > 0 ? result.executed / seconds : 0;
+        result.throughput_ci = 0;
+
+        return result;
+    }
+
+    // Execute the queries as configured by the measurement: warmup passes first, then the recorded repetitions.
+    template <typename TQuery, typename TExecute>
+    QueryRunResult measure(std::vector<TQuery> &queries, size_t chunk_size, unsigned int n_threads, TExecute execute)
+    {
+        double max_seconds = _measurement.mode == Measurement::FIXED_TIME ? _measurement.max_seconds : 0;
+
+        QueryRunResult result;
+        result.total_executed = 0;
+
+        for (unsigned int pass = 0; pass < _measurement.warmup_passes; pass++)
+        {
+            result.total_executed += execute_concurrent(queries, chunk_size, n_threads, max_seconds, execute).executed;
+        }
+
+        std::vector<double> throughputs;
+
+        for (unsigned int repetition = 0; repetition < std::max(1u, _measurement.repetitions); repetition++)
+        {
+            auto run = execute_concurrent(queries, chunk_size, n_threads, max_seconds, execute);
+
+            throughputs.push_back(run.throughput);
+            result.latencies.merge(run.latencies);
+            result.executed = run.executed;
+            result.total_executed += run.executed;
+        }
+
+        result.throughput = sample_mean(throughputs);
+        result.throughput_ci = ci95_half_width(throughputs);
+
+        return result;
+    }
+
+    // Run one query workload on every thread count, then in locality-sorted batches of every batch size.
+    template <typename TQuery, typename TExecute>
+    WorkloadResult execute_workload(std::string description, std::vector<TQuery> &queries, TExecute execute)
+    {
+        WorkloadResult workload;
+        workload.n_queries = queries.size();
+
+        for (auto n_threads : _query_threads)
+        {
+            std::cout << "Executing " << description << " on " << n_threads << " thread(s)... " << std::endl;
+
+            auto result = measure(queries, QUERY_CHUNK_SIZE, n_threads, execute);
+            print_latencies(result.latencies);
+
+            if (workload.throughputs.empty())
+            {
+                workload.latencies = result.latencies;
+                workload.executed = result.executed;
+            }
+
+            workload.throughputs.push_back(result.throughput);
+            workload.throughput_cis.push_back(result.throughput_ci);
+            workload.total_executed += result.total_executed;
+            workload.runs.push_back(result);
+        }
+
+        if (_batch_sizes.empty())
+        {
+            return workload;
+        }
+
+        // Like a service that buffers incoming requests for a moment, every thread takes its queries in batches in
+        // arrival order, sorts each batch on its locality key and executes it. Sorting is timed along with the queries.
+        auto execute_batch = [this, &execute](QuerySlice<TQuery> batch, LatencyHistogram &latencies, ProgressCounter &progress) {
+            std::vector<uint64_t> keys(batch.size());
+            std::vector<uint32_t> order(batch.size());
+
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                keys[i] = locality_key(batch[i]);
+            }
+
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+            execute(QuerySlice<TQuery>(&batch[0], batch.size(), order.data()), latencies, progress);
+        };
+
+        for (auto batch_size : _batch_sizes)
+        {
+            std::cout << "Executing " << description << " in batches of " << batch_size << " on " << _query_threads.front() << " thread(s)... " << std::endl;
+
+            auto result = measure(queries, std::max<size_t>(1, batch_size), _query_threads.front(), execute_batch);
+            print_latencies(result.latencies);
+
+            workload.batched_throughputs.push_back(result.throughput);
+            workload.total_executed += result.total_executed;
+            workload.runs.push_back(result);
+        }
+
+        return workload;
+    }
+
+    // Execute n queries of the workload from position next onwards, wrapping around its end.
+    template <typename TQuery, typename TExecute>
+    static void execute_round_robin(std::vector<TQuery> &queries, size_t &next, size_t n, TExecute execute)
+    {
+        while (n > 0)
+        {
+            size_t count = std::min(n, queries.size() - next);
+            execute(QuerySlice<TQuery>(queries.data() + next, count));
+            next = (next + count) % queries.size();
+            n -= count;
+        }
+    }
+
+    // Execute the operation mix on a single thread, drawing every operation at random with a fixed seed. Queries are
+    // taken round-robin from the given workloads, and consecutive queries of one kind go to the executor as one slice.
+    // Removed points become candidates for inserts, which revive them next to a random live point.
+    MixedResult execute_mixed(std::unique_ptr<TIndex> &index, std::vector<TGeom> &geometry, std::vector<TDQuery> &dqueries, std::vector<TRQuery> &rqueries, std::vector<TKQuery> &kqueries)
+    {
+        const auto &mix = _mixed_workload;
+        MixedResult result;
+
+        // Operation kinds 0 to 5: distance query, range query, insert, remove, move and kNN query.
+        std::vector<double> weights = {dqueries.empty() ? 0 : mix.distance_queries, rqueries.empty() ? 0 : mix.range_queries, mix.inserts, mix.removes, mix.moves, kqueries.empty() ? 0 : mix.knn_queries};
+
+        if (geometry.empty() || std::accumulate(weights.begin(), weights.end(), 0.0) <= 0)
+        {
+            return result;
+        }
+
+        std::mt19937_64 random(42);
+        std::discrete_distribution<int> pick_kind(weights.begin(), weights.end());
+        std::uniform_real_distribution<double> pick_step(-mix.max_step, mix.max_step);
+
+        // Live and removed point ids, with the position of every id in its list for constant-time removal.
+        std::vector<uint32_t> live(geometry.size());
+        std::vector<uint32_t> removed;
+        std::vector<uint32_t> slot(geometry.size());
+        std::iota(live.begin(), live.end(), 0);
+        std::iota(slot.begin(), slot.end(), 0);
+
+        auto pick = [&random](const std::vector<uint32_t> &ids) { return ids[std::uniform_int_distribution<size_t>(0, ids.size() - 1)(random)]; };
+        auto move_id = [&slot](uint32_t id, std::vector<uint32_t> &from, std::vector<uint32_t> &to) {
+            from[slot[id]] = from.back();
+            slot[from.back()] = slot[id];
+            from.pop_back();
+            slot[id] = to.size();
+            to.push_back(id);
+        };
+
+        size_t next_dquery = 0;
+        size_t next_rquery = 0;
+        size_t next_kquery = 0;
+        ProgressCounter noop;
+
+        ProgressTracker pt;
+
+        // Time-limited like a query pass.
+        double max_seconds = _measurement.mode == Measurement::FIXED_TIME ? _measurement.max_seconds : 0;
+        auto start_time = std::chrono::steady_clock::now();
+        int kind = pick_kind(random);
+
+        while (result.operations < mix.n_operations)
+        {
+            size_t count = 1;
+            int next_kind = pick_kind(random);
+
+            if (kind == 0 || kind == 1 || kind == 5)
+            {
+                while (next_kind == kind && result.operations + count < mix.n_operations)
+                {
+                    count++;
+                    next_kind = pick_kind(random);
+                }
+
+                if (kind == 0)
+                {
+                    execute_round_robin(dqueries, next_dquery, count, [&](QuerySlice<TDQuery> slice) {
+                        execute_distance_queries(index.get(), slice, result.dquery.latencies, noop);
+                    });
+                }
+                else if (kind == 1)
+                {
+                    execute_round_robin(rqueries, next_rquery, count, [&](QuerySlice<TRQuery> slice) {
+                        execute_range_queries(index.get(), slice, result.rquery.latencies, noop);
+                    });
+                }
+                else
+                {
+                    execute_round_robin(kqueries, next_kquery, count, [&](QuerySlice<TKQuery> slice) {
+                        execute_knn_queries(index.get(), slice, mix.knn_k, result.kquery.latencies, noop);
+                    });
+                }
+            }
+            else
+            {
+                // Inserts need a removed point and removes keep at least one live point, otherwise the point is moved.
+                PointUpdate update;
+                update.kind = kind == 2 && !removed.empty() ? PointUpdate::INSERT : kind == 3 && live.size() > 1 ? PointUpdate::REMOVE : PointUpdate::MOVE;
+                update.id = update.kind == PointUpdate::INSERT ? pick(removed) : pick(live);
+                update.anchor = update.kind == PointUpdate::INSERT ? pick(live) : update.id;
+                update.dx = pick_step(random);
+                update.dy = pick_step(random);
+
+                auto update_start = std::chrono::steady_clock::now();
+                apply_update(index, geometry, update);
+                auto update_time = std::chrono::steady_clock::now() - update_start;
+
+                result.update_latencies.record(update_time);
+                result.updates++;
+
+                if (update.kind == PointUpdate::INSERT)
+                {
+                    move_id(update.id, removed, live);
+                }
+                else if (update.kind == PointUpdate::REMOVE)
+                {
+                    move_id(update.id, live, removed);
+                }
+            }
+
+            result.operations += count;
+            kind = next_kind;
+            pt.set(result.operations, mix.n_operations);
+
+            if (max_seconds > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() >= max_seconds)
+            {
+                break;
+            }
+        }
+
+        pt.stop();
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+        return result;
+    }
+
+    static void print_latencies(const LatencyHistogram &latencies)
+    {
+        std::cout << "Latency p50 " << latencies.percentile(0.50) / 1e3
+                  << " us, p95 " << latencies.percentile(0.95) / 1e3
+                  << " us, p99 " << latencies.percentile(0.99) / 1e3
+                  << " us, max " << latencies.max() / 1e3 << " us." << std::endl;
+    }
+
+    static void write_label(std::ostream &out, std::string label)
+    {
+        out << label << std::string(std::max<int>(1, 18 - label.size()), ' ') << "| ";
+    }
+
+    static size_t total_executed(const std::vector<WorkloadResult> &results)
+    {
+        size_t total = 0;
+
+        for (const auto &result : results)
+        {
+            total += result.total_executed;
+        }
+
+        return total;
+    }
+
+    // Write one line of hardware counters, in the order of the perf_events line, each divided by per.
+    static void write_counters(std::ostream &out, std::string label, const PerfCounters &counters, double per)
+    {
+        write_label(out, label);
+        write_list(out, counters.values(per));
+        out << std::endl;
+    }
+
+    // Write the p50/p95/p99/max lines of a report for the given workloads, in microseconds.
+    static void write_latencies(std::ostream &out, std::string prefix, const std::vector<WorkloadResult> &results)
+    {
+        std::vector<std::pair<std::string, double>> stats = {{"p50", 0.50}, {"p95", 0.95}, {"p99", 0.99}, {"max", 1.0}};
+
+        for (const auto &stat : stats)
+        {
+            std::vector<double> values;
+
+            for (const auto &result : results)
+            {
+                values.push_back((stat.second == 1.0 ? result.latencies.max() : result.latencies.percentile(stat.second)) / 1e3);
+            }
+
+            write_label(out, prefix + "_" + stat.first);
+            write_list(out, values);
+            out << " us" << std::endl;
+        }
+    }
+
+    // Write the throughput of every workload on the first thread count.
+    static void write_throughputs(std::ostream &out, std::string label, const std::vector<WorkloadResult> &results)
+    {
+        std::vector<float> throughputs;
+
+        for (const auto &result : results)
+        {
+            throughputs.push_back(result.throughputs.front());
+        }
+
+        write_label(out, label);
+        write_list(out, throughputs);
+        out << " queries/s" << std::endl;
+    }
+
+    // Confidence interval of the throughput on the first thread count, if repeated, and the fraction of each query
+    // file that was executed, if time-limited.
+    void write_measurement(std::ostream &out, std::string prefix, const std::vector<WorkloadResult> &results) const
+    {
+        std::vector<float> cis;
+        std::vector<float> coverage;
+
+        for (const auto &result : results)
+        {
+            cis.push_back(result.throughput_cis.front());
+            coverage.push_back(result.n_queries > 0 ? (float)result.executed / result.n_queries : 0);
+        }
+
+        if (_measurement.repetitions > 1)
+        {
+            write_label(out, prefix + "_ci95");
+            write_list(out, cis);
+            out << " queries/s" << std::endl;
+        }
+
+        if (_measurement.mode == Measurement::FIXED_TIME)
+        {
+            write_label(out, prefix + "_coverage");
+            write_list(out, coverage);
+            out << std::endl;
+        }
+    }
+
+    // Write one list per workload, as selected by values(result).
+    template <typename TValues>
+    static void write_nested(std::ostream &out, std::string label, const std::vector<WorkloadResult> &results, TValues values, std::string unit = " queries/s")
+    {
+        write_label(out, label);
+        out << "[";
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            out << (i == 0 ? "" : ", ");
+            write_list(out, values(results[i]));
+        }
+
+        out << "]" << unit << std::endl;
+    }
+
+protected:
+    // Selectivity of every query file of the current run (NaN where unknown), set before build_index is called so
+    // that indexes can be tuned to the workload.
+    std::vector<double> _query_selectivities;
 
 public:
-    BaseExperimentRunner(std::string name, std::string executable_name) : _name(name), _executable_name(executable_name){};
+    BaseExperimentRunner(std::string name) : _name(name){};
+
+    // Run every query file once per thread count. The index is shared read-only between the threads.
+    void set_query_threads(std::vector<unsigned int> thread_counts)
+    {
+        _query_threads = thread_counts.empty() ? std::vector<unsigned int>{1} : thread_counts;
+    }
+
+    // Run every kNN query file once per k.
+    void set_knn_k(std::vector<size_t> k)
+    {
+        _knn_k = k;
+    }
+
+    // Write every built index that supports it to a snapshot in this directory and map it back before querying.
+    void set_snapshot_directory(std::string directory)
+    {
+        _snapshot_directory = directory;
+    }
+
+    // Write a CPU profile of every phase (load, build and each query workload) to this directory.
+    void set_profile_directory(std::string directory)
+    {
+        _profile_directory = directory;
+    }
+
+    // Warmup, repetitions and time limit of every query workload.
+    void set_measurement(Measurement measurement)
+    {
+        _measurement = measurement;
+    }
+
+    // Additionally replay every workload in batches of these sizes, each sorted along a space-filling curve, on the
+    // first thread count.
+    void set_query_batch_sizes(std::vector<size_t> batch_sizes)
+    {
+        _batch_sizes = batch_sizes;
+    }
+
+    // After the query workloads, interleave updates with queries in this mix. Only runs for indexes that support updates.
+    void set_mixed_workload(MixedWorkload mix)
+    {
+        _run_mixed = true;
+        _mixed_workload = mix;
+    }
 
     virtual std::vector<TGeom> load_geometry(std::string file_path, std::function<void(size_t, size_t)> progress) = 0;
     virtual std::vector<TDQuery> load_distance_queries(std::string file_path, std::function<void(size_t, size_t)> progress) = 0;
     virtual std::vector<TRQuery> load_range_queries(std::string file_path, std::function<void(size_t, size_t)> progress) = 0;
+    virtual std::vector<TKQuery> load_knn_queries(std::string file_path, std::function<void(size_t, size_t)> progress) = 0;
 
     virtual std::unique_ptr<TIndex> build_index(std::vector<TGeom> &geometry, std::function<void(size_t, size_t)> progress) = 0;
-    virtual void execute_distance_queries(TIndex *index, std::vector<TDQuery> &queries, std::function<void(size_t, size_t)> progress) = 0;
-    virtual void execute_range_queries(TIndex *index, std::vector<TRQuery> &queries, std::function<void(size_t, size_t)> progress) = 0;
 
-    void run(std::string run_name, std::string geom_file, std::vector<std::string> dquery_files, std::vector<std::string> rquery_files)
+    // Bytes occupied by the index structure itself, as counted by the index. Returns 0 if the index cannot tell.
+    virtual size_t index_structural_bytes(TIndex *index)
+    {
+        return 0;
+    }
+
+    // Extra (key, value) lines describing the built index, appended to the report.
+    virtual std::vector<std::pair<std::string, std::string>> index_properties(TIndex *index)
+    {
+        return {};
+    }
+
+    // Write the index to a snapshot at file_path and return its size in bytes, or 0 if the index has no snapshot
+    // support.
+    virtual size_t save_index(TIndex *index, std::string file_path)
+    {
+        return 0;
+    }
+
+    // Map an index back from a snapshot written by save_index.
+    virtual std::unique_ptr<TIndex> load_index(std::string file_path)
+    {
+        throw std::runtime_error("This index cannot be loaded from a snapshot.");
+    }
+
+    // Whether apply_update is implemented, i.e. the index can run a mixed workload.
+    virtual bool supports_updates()
+    {
+        return false;
+    }
+
+    // Apply one update to the index and to geometry, which holds the current position of every point. The index may
+    // be replaced, e.g. by a rebuild. Updates are never applied concurrently with queries.
+    virtual void apply_update(std::unique_ptr<TIndex> &index, std::vector<TGeom> &geometry, const PointUpdate &update)
+    {
+        throw std::runtime_error("This index does not support updates.");
+    }
+
+    // Position of a query along a space-filling curve, used to sort query batches. The default keeps file order.
+    virtual uint64_t locality_key(const TDQuery &query)
+    {
+        return 0;
+    }
+
+    virtual uint64_t locality_key(const TRQuery &query)
+    {
+        return 0;
+    }
+
+    virtual uint64_t locality_key(const TKQuery &query)
+    {
+        return 0;
+    }
+
+    // Executors may be called concurrently on different slices, so any mutable query state must be local to the call.
+    // Every query is timed individually into the given histogram. Time limits are enforced by the caller, which
+    // hands out short slices, so executors run every query they are given.
+    virtual void execute_distance_queries(TIndex *index, QuerySlice<TDQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress) = 0;
+    virtual void execute_range_queries(TIndex *index, QuerySlice<TRQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress) = 0;
+    virtual void execute_knn_queries(TIndex *index, QuerySlice<TKQuery> queries, size_t k, LatencyHistogram &latencies, ProgressCounter &progress) = 0;
+
+    // Write results/<full_name>.csv with one record per measurement: every query file (and k) on every thread count
+    // and batch size, each with the metadata of the run, for the notebooks and the compare tool.
+    void write_records(std::string full_name, std::string geom_file, size_t n_geometries, double geometry_size, double index_size, double peak_rss, double build_seconds,
+                       const std::vector<std::string> &dquery_files, const std::vector<WorkloadResult> &dquery_results,
+                       const std::vector<std::string> &rquery_files, const std::vector<WorkloadResult> &rquery_results,
+                       const std::vector<std::string> &kquery_files, const std::vector<WorkloadResult> &kquery_results)
+    {
+        std::ofstream file("results/" + full_name + ".csv");
+        file << std::setprecision(10);
+
+        file << "run_name,git_commit,cpu,hardware_threads,geometry_file,n_geometries,geometry_size_mb,index_size_mb,peak_rss_mb,build_seconds,"
+             << "measurement,repetitions,workload,query_file,k,query_threads,batch_size,executed,throughput,throughput_ci95,"
+             << "latency_p50_us,latency_p95_us,latency_p99_us,latency_max_us" << std::endl;
+
+        std::string run = csv_field(full_name) + "," + csv_field(build_commit()) + "," + csv_field(host_cpu()) + "," + std::to_string(hardware_threads()) + "," + csv_field(geom_file);
+        std::string measurement = _measurement.mode == Measurement::FIXED_TIME ? "fixed_time" : "fixed_work";
+
+        auto write = [&](std::string workload, std::string query_file, size_t k, const WorkloadResult &result) {
+            for (size_t i = 0; i < result.runs.size(); i++)
+            {
+                const auto &measured = result.runs[i];
+                bool batched = i >= _query_threads.size();
+
+                file << run << "," << n_geometries << "," << geometry_size << "," << index_size << "," << peak_rss << "," << build_seconds << ","
+                     << measurement << "," << std::max(1u, _measurement.repetitions) << "," << workload << "," << csv_field(query_file) << "," << k << ","
+                     << (batched ? _query_threads.front() : _query_threads[i]) << "," << (batched ? _batch_sizes[i - _query_threads.size()] : 0) << ","
+                     << measured.executed << "," << measured.throughput << "," << measured.throughput_ci << ","
+                     << measured.latencies.percentile(0.50) / 1e3 << "," << measured.latencies.percentile(0.95) / 1e3 << ","
+                     << measured.latencies.percentile(0.99) / 1e3 << "," << measured.latencies.max() / 1e3 << std::endl;
+            }
+        };
+
+        for (size_t i = 0; i < dquery_results.size(); i++)
+        {
+            write("dquery", dquery_files[i], 0, dquery_results[i]);
+        }
+
+        for (size_t i = 0; i < rquery_results.size(); i++)
+        {
+            write("rquery", rquery_files[i], 0, rquery_results[i]);
+        }
+
+        // kNN results are ordered by file, then k.
+        for (size_t i = 0; i < kquery_results.size(); i++)
+        {
+            write("kquery", kquery_files[i / _knn_k.size()], _knn_k[i % _knn_k.size()], kquery_results[i]);
+        }
+    }
+
+    // Profile file of one phase of the run, or an empty name if profiling is off.
+    std::string profile_file(std::string full_name, std::string phase) const
+    {
+        return _profile_directory.empty() ? "" : _profile_directory + "/" + full_name + "." + phase + ".prof";
+    }
+
+    void run(std::string run_name, std::string geom_file, std::vector<std::string> dquery_files, std::vector<std::string> rquery_files, std::vector<std::string> kquery_files = {})
     {
         std::string full_name = _name + '_' + run_name;
 
@@ -54,73 +787,175 @@ public:
 
         std::cout << "Loading geometry..." << std::endl;
 
+        // Hardware counters of every phase, normalized per point or per query executed in the report.
+        PerfCounters load_counters;
+        PerfCounters build_counters;
+        PerfCounters dquery_counters;
+        PerfCounters rquery_counters;
+        PerfCounters kquery_counters;
+
+        // Geometry memory is measured like index memory below, as the growth in bytes allocated while loading.
+        auto loading_before = allocated_bytes();
+
         ProgressTracker pt_load_geometry;
+        CpuProfile load_profile(profile_file(full_name, "load"));
+        load_counters.start();
         auto geometry = load_geometry(geom_file, pt_load_geometry.bind());
+        load_counters.stop();
+        load_profile.stop();
         pt_load_geometry.stop();
 
-        std::cout << "Done. Loaded " << geometry.size() << " objects." << std::endl;
+        auto loading_after = allocated_bytes();
+        double geometry_size = loading_after > loading_before ? (loading_after - loading_before) / 1e6 : 0;
+
+        std::cout << "Done. Loaded " << geometry.size() << " objects (" << geometry_size << " MB)." << std::endl;
 
         std::cout << "Building index..." << std::endl;
 
-        auto hp_name = "tmp/" + full_name; // this causes the dumps to be written to the tmp/ folder.
+        _query_selectivities.clear();
+
+        for (const auto &query_file : dquery_files)
+        {
+            _query_selectivities.push_back(query_file_selectivity(query_file));
+        }
+
+        for (const auto &query_file : rquery_files)
+        {
+            _query_selectivities.push_back(query_file_selectivity(query_file));
+        }
 
-        HeapProfilerStart(hp_name.c_str());
+        // Index memory is the growth in bytes allocated through tcmalloc while building.
+        auto allocated_before = allocated_bytes();
+        reset_peak_rss();
 
         ProgressTracker pt_build_index;
+        CpuProfile build_profile(profile_file(full_name, "build"));
+        build_counters.start();
         auto index = build_index(geometry, pt_build_index.bind());
+        build_counters.stop();
+        build_profile.stop();
         pt_build_index.stop();
 
-        HeapProfilerDump("done");
-        HeapProfilerStop();
+        auto allocated_after = allocated_bytes();
+        double index_size = allocated_after > allocated_before ? (allocated_after - allocated_before) / 1e6 : 0;
+        double structural_size = index_structural_bytes(index.get()) / 1e6;
+        double peak_rss = peak_rss_bytes() / 1e6;
+        auto properties = index_properties(index.get());
 
-        // Parse heapprofile using bash.
-        std::stringstream pprof_command;
-        pprof_command << "pprof "
-                      << "--text "
-                      << "--inuse_space "
-                      << _executable_name << " "
-                      << "tmp/$(ls tmp | grep " << full_name << " | tail -1)" // last dump in folder
-                      << " | grep ::build_index"                              // extract relevant function
-                      << " | awk -F ' +' '{ print $5 }'";                     // extract memory allocation field
+        std::cout << "Done. Index uses " << index_size << " MB (" << 1e6 * index_size / std::max<size_t>(1, geometry.size()) << " bytes/point)." << std::endl;
 
-        auto index_size = exec(pprof_command.str().c_str());
+        // Snapshot the index and map it back from disk with a cold page cache, as after a restart. The queries below
+        // then run on the mapped index, the first of them timed on its own.
+        size_t snapshot_size = 0;
+        double reload_time = 0;
+        double first_query_latency = 0;
 
-        if (index_size.empty())
+        if (!_snapshot_directory.empty())
         {
-            index_size = "-1";
-        }
-        else
-        {
-            index_size.pop_back(); // remove new-line at the end
+            std::string snapshot_file = _snapshot_directory + "/" + full_name + ".snap";
+
+            std::cout << "Writing snapshot..." << std::endl;
+            snapshot_size = save_index(index.get(), snapshot_file);
+
+            if (snapshot_size > 0)
+            {
+                evict_page_cache(snapshot_file);
+
+                auto reload_start = std::chrono::steady_clock::now();
+                index = load_index(snapshot_file);
+                reload_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - reload_start).count();
+
+                if (!dquery_files.empty())
+                {
+                    auto queries = load_distance_queries(dquery_files.front(), [](auto i, auto n) {});
+
+                    if (!queries.empty())
+                    {
+                        LatencyHistogram first_query;
+                        ProgressCounter noop;
+                        execute_distance_queries(index.get(), QuerySlice<TDQuery>(queries.data(), 1), first_query, noop);
+                        first_query_latency = first_query.max() / 1e3;
+                    }
+                }
+
+                std::cout << "Done. Reloaded " << snapshot_size / 1e6 << " MB in " << reload_time << " ms." << std::endl;
+            }
         }
-        
+
         // 2. Execute queries
 
-        std::vector<float> rquery_throughputs;
-        std::vector<float> dquery_throughputs;
+        // One workload per distance and range query file, and one per kNN query file and k (ordered by file, then k).
+        std::vector<WorkloadResult> dquery_results;
+        std::vector<WorkloadResult> rquery_results;
+        std::vector<WorkloadResult> kquery_results;
 
-        for (const auto &dquery_file : dquery_files)
+        for (size_t i = 0; i < dquery_files.size(); i++)
         {
-            std::cout << "Executing distance queries from <" << dquery_file << ">... " << std::endl;
+            const auto &dquery_file = dquery_files[i];
             auto queries = load_distance_queries(dquery_file, [](auto i, auto n) {});
 
-            ProgressTracker pt_execute_distance_queries;
-            execute_distance_queries(index.get(), queries, pt_execute_distance_queries.bind());
-            pt_execute_distance_queries.stop();
-
-            dquery_throughputs.push_back(pt_execute_distance_queries.get_throughput());
+            CpuProfile profile(profile_file(full_name, "dquery_" + std::to_string(i)));
+            dquery_counters.start();
+            dquery_results.push_back(execute_workload("distance queries from <" + dquery_file + ">", queries, [&](QuerySlice<TDQuery> slice, LatencyHistogram &latencies, ProgressCounter &progress) {
+                execute_distance_queries(index.get(), slice, latencies, progress);
+            }));
+            dquery_counters.stop();
+            profile.stop();
         }
 
-        for (const auto &rquery_file : rquery_files)
+        for (size_t i = 0; i < rquery_files.size(); i++)
         {
-            std::cout << "Executing range queries from <" << rquery_file << ">... " << std::endl;
+            const auto &rquery_file = rquery_files[i];
             auto queries = load_range_queries(rquery_file, [](auto i, auto n) {});
 
-            ProgressTracker pt_execute_range_queries;
-            execute_range_queries(index.get(), queries, pt_execute_range_queries.bind());
-            pt_execute_range_queries.stop();
+            CpuProfile profile(profile_file(full_name, "rquery_" + std::to_string(i)));
+            rquery_counters.start();
+            rquery_results.push_back(execute_workload("range queries from <" + rquery_file + ">", queries, [&](QuerySlice<TRQuery> slice, LatencyHistogram &latencies, ProgressCounter &progress) {
+                execute_range_queries(index.get(), slice, latencies, progress);
+            }));
+            rquery_counters.stop();
+            profile.stop();
+        }
+
+        for (size_t i = 0; i < kquery_files.size(); i++)
+        {
+            const auto &kquery_file = kquery_files[i];
+            auto queries = load_knn_queries(kquery_file, [](auto i, auto n) {});
+
+            CpuProfile profile(profile_file(full_name, "kquery_" + std::to_string(i)));
+            kquery_counters.start();
 
-            rquery_throughputs.push_back(pt_execute_range_queries.get_throughput());
+            for (auto k : _knn_k)
+            {
+                kquery_results.push_back(execute_workload(std::to_string(k) + "-NN queries from <" + kquery_file + ">", queries, [&](QuerySlice<TKQuery> slice, LatencyHistogram &latencies, ProgressCounter &progress) {
+                    execute_knn_queries(index.get(), slice, k, latencies, progress);
+                }));
+            }
+
+            kquery_counters.stop();
+            profile.stop();
+        }
+
+        // Updates change the geometry, so the mixed workload runs last.
+        MixedResult mixed;
+        bool ran_mixed = _run_mixed && supports_updates() && !dquery_files.empty() && !rquery_files.empty();
+
+        if (ran_mixed)
+        {
+            auto dqueries = load_distance_queries(dquery_files.front(), [](auto i, auto n) {});
+            auto rqueries = load_range_queries(rquery_files.front(), [](auto i, auto n) {});
+            std::vector<TKQuery> kqueries;
+
+            if (!kquery_files.empty() && _mixed_workload.knn_queries > 0)
+            {
+                kqueries = load_knn_queries(kquery_files.front(), [](auto i, auto n) {});
+            }
+
+            std::cout << "Executing mixed workload of " << _mixed_workload.n_operations << " operations... " << std::endl;
+            mixed = execute_mixed(index, geometry, dqueries, rqueries, kqueries);
+
+            std::cout << "Done. Applied " << mixed.updates << " updates at " << (mixed.seconds > 0 ? mixed.updates / mixed.seconds : 0) << " updates/s." << std::endl;
+            print_latencies(mixed.update_latencies);
         }
 
         // 3. Write output
@@ -132,46 +967,164 @@ public:
         file << "run_name          | " << full_name << std::endl
              << "geometry_file     | " << geom_file << std::endl
              << "n_geometries      | " << geometry.size() << std::endl
+             << "geometry_size     | " << geometry_size << " MB" << std::endl
              << "index_size        | " << index_size << " MB" << std::endl
+             << "bytes_per_point   | " << 1e6 * index_size / std::max<size_t>(1, geometry.size()) << std::endl
+             << "index_struct_size | " << (structural_size > 0 ? std::to_string(structural_size) : "n/a") << " MB" << std::endl
+             << "peak_rss          | " << peak_rss << " MB" << std::endl
              << "build_time        | " << pt_build_index.get_time() << " hh:mm:ss" << std::endl
-             << "dquery_file       | [";
+             << "measurement       | " << (_measurement.mode == Measurement::FIXED_TIME ? "fixed_time" : "fixed_work") << std::endl;
+
+        if (_measurement.mode == Measurement::FIXED_TIME)
+        {
+            file << "max_seconds       | " << _measurement.max_seconds << " s" << std::endl;
+        }
+
+        file << "warmup_passes     | " << _measurement.warmup_passes << std::endl
+             << "repetitions       | " << std::max(1u, _measurement.repetitions) << std::endl;
+
+        if (snapshot_size > 0)
+        {
+            file << "snapshot_size     | " << snapshot_size / 1e6 << " MB" << std::endl
+                 << "reload_time       | " << reload_time << " ms" << std::endl
+                 << "first_query_time  | " << first_query_latency << " us" << std::endl;
+        }
+
+        for (const auto &property : properties)
+        {
+            write_label(file, property.first);
+            file << property.second << std::endl;
+        }
+
+        // The plain throughput lines hold the first thread count, the scaling lines hold every thread count.
+        file << "dquery_file       | ";
+        write_list(file, dquery_files);
+        file << std::endl;
+        write_throughputs(file, "dquery_throughput", dquery_results);
+        write_measurement(file, "dquery", dquery_results);
+
+        file << "rquery_file       | ";
+        write_list(file, rquery_files);
+        file << std::endl;
+        write_throughputs(file, "rquery_throughput", rquery_results);
+        write_measurement(file, "rquery", rquery_results);
 
-        for (const auto &dquery_file : dquery_files)
+        if (!kquery_files.empty())
         {
-            file << dquery_file << ", ";
+            file << "kquery_file       | ";
+            write_list(file, kquery_files);
+            file << std::endl
+                 << "kquery_k          | ";
+            write_list(file, _knn_k);
+            file << std::endl;
+            write_throughputs(file, "kquery_throughput", kquery_results);
+            write_measurement(file, "kquery", kquery_results);
         }
 
-        file.seekp(-2, std::ios_base::cur); // delete last ", "
-        file << "]" << std::endl
-             << "dquery_throughput | [";
+        write_latencies(file, "dquery", dquery_results);
+        write_latencies(file, "rquery", rquery_results);
 
-        for (const auto &dquery_throughput : dquery_throughputs)
+        if (!kquery_files.empty())
         {
-            file << dquery_throughput << ", ";
+            write_latencies(file, "kquery", kquery_results);
         }
 
-        file.seekp(-2, std::ios_base::cur);
-        file << "] queries/s" << std::endl
-             << "rquery_file       | [";
+        if (_query_threads.size() > 1)
+        {
+            file << "query_threads     | ";
+            write_list(file, _query_threads);
+            file << std::endl;
+
+            write_nested(file, "dquery_scaling", dquery_results, [](const WorkloadResult &result) { return result.throughputs; });
+            write_nested(file, "rquery_scaling", rquery_results, [](const WorkloadResult &result) { return result.throughputs; });
 
-        for (const auto &rquery_file : rquery_files)
+            if (!kquery_files.empty())
+            {
+                write_nested(file, "kquery_scaling", kquery_results, [](const WorkloadResult &result) { return result.throughputs; });
+            }
+        }
+
+        // Batched throughput on the first thread count, and its gain over replaying the queries in file order.
+        if (!_batch_sizes.empty())
         {
-            file << rquery_file << ", ";
+            file << "batch_sizes       | ";
+            write_list(file, _batch_sizes);
+            file << std::endl;
+
+            auto batched = [](const WorkloadResult &result) { return result.batched_throughputs; };
+            auto gain = [](const WorkloadResult &result) {
+                std::vector<float> gains;
+
+                for (auto throughput : result.batched_throughputs)
+                {
+                    gains.push_back(result.throughputs.front() > 0 ? throughput / result.throughputs.front() : 0);
+                }
+
+                return gains;
+            };
+
+            write_nested(file, "dquery_batched", dquery_results, batched);
+            write_nested(file, "rquery_batched", rquery_results, batched);
+            write_nested(file, "dquery_batch_gain", dquery_results, gain, "");
+            write_nested(file, "rquery_batch_gain", rquery_results, gain, "");
+
+            if (!kquery_files.empty())
+            {
+                write_nested(file, "kquery_batched", kquery_results, batched);
+                write_nested(file, "kquery_batch_gain", kquery_results, gain, "");
+            }
         }
 
-        file.seekp(-2, std::ios_base::cur);
-        file << "]" << std::endl
-             << "rquery_throughput | [";
+        // Counters per point loaded and built, and per query executed over all runs of the query files.
+        if (load_counters.available())
+        {
+            file << "perf_events       | ";
+            write_list(file, load_counters.names());
+            file << std::endl;
+
+            write_counters(file, "load_counters", load_counters, geometry.size());
+            write_counters(file, "build_counters", build_counters, geometry.size());
+            write_counters(file, "dquery_counters", dquery_counters, total_executed(dquery_results));
+            write_counters(file, "rquery_counters", rquery_counters, total_executed(rquery_results));
+
+            if (!kquery_files.empty())
+            {
+                write_counters(file, "kquery_counters", kquery_counters, total_executed(kquery_results));
+            }
+        }
+        else
+        {
+            file << "perf_events       | n/a" << std::endl;
+        }
 
-        for (const auto &rquery_throughput : rquery_throughputs)
+        // Operations and updates per second over the whole mixed run.
+        if (ran_mixed)
         {
-            file << rquery_throughput << ", ";
+            file << "mixed_operations  | " << mixed.operations << std::endl
+                 << "mixed_weights     | ";
+            write_list(file, std::vector<double>{_mixed_workload.distance_queries, _mixed_workload.range_queries, _mixed_workload.inserts, _mixed_workload.removes, _mixed_workload.moves, _mixed_workload.knn_queries});
+            file << std::endl
+                 << "mixed_throughput  | " << (mixed.seconds > 0 ? mixed.operations / mixed.seconds : 0) << " operations/s" << std::endl
+                 << "mixed_update_rate | " << (mixed.seconds > 0 ? mixed.updates / mixed.seconds : 0) << " updates/s" << std::endl;
+
+            WorkloadResult updates;
+            updates.latencies = mixed.update_latencies;
+
+            write_latencies(file, "mixed_update", {updates});
+            write_latencies(file, "mixed_dquery", {mixed.dquery});
+            write_latencies(file, "mixed_rquery", {mixed.rquery});
+
+            if (mixed.kquery.latencies.count() > 0)
+            {
+                write_latencies(file, "mixed_kquery", {mixed.kquery});
+            }
         }
 
-        file.seekp(-2, std::ios_base::cur);
-        file << "] queries/s" << std::endl;
         file.close();
 
-        std::cout << "Report written to " << full_name << ".txt." << std::endl;
+        write_records(full_name, geom_file, geometry.size(), geometry_size, index_size, peak_rss, pt_build_index.get_seconds(),
+                      dquery_files, dquery_results, rquery_files, rquery_results, kquery_files, kquery_results);
+
+        std::cout << "Report written to " << full_name << ".txt and " << full_name << ".csv." << std::endl;
     }
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <cmath>
 #include "geos/index/SpatialIndex.h"
 #include "geos/geom/GeometryFactory.h"
 #include "geos/geom/Envelope.h"
@@ -9,35 +10,92 @@
 #include "../../utils/progress.h"
 #include "../../utils/proj.h"
 #include "../../utils/data.h"
+#include "../../utils/refine.h"
+#include "../../utils/knn.h"
+#include "../../utils/hilbert.h"
 
 typedef DistanceQuery<std::unique_ptr<geos::geom::Point>> GeosDistanceQuery;
 typedef RangeQuery<geos::geom::Envelope> GeosRangeQuery;
-
-template <typename TIndex>
-class GeosIndexExperimentRunner : public BaseExperimentRunner<TIndex, std::unique_ptr<geos::geom::Point>, GeosDistanceQuery, GeosRangeQuery>
+typedef KnnQuery<std::unique_ptr<geos::geom::Point>> GeosKnnQuery;
+
+// Loads geometry and queries into the projected CRS as GEOS objects. Executors are left to the subclass.
+//
+// Points are loaded as TGeom: a geos::geom::Point each by default, or a degenerate geos::geom::Envelope each for the
+// point handle runners (handles.h), which keep the coordinates in one contiguous array.
+template <typename TIndex, typename TGeom = std::unique_ptr<geos::geom::Point>>
+class GeosExperimentRunner : public BaseExperimentRunner<TIndex, TGeom, GeosDistanceQuery, GeosRangeQuery, GeosKnnQuery>
 {
-private:
-    ProjWrapper _transformer;
+protected:
+    ParallelProjector _projector;
     geos::geom::GeometryFactory::Ptr _factory;
 
+    // Geometry instances keep a non-atomic reference count on their factory, so every load thread creates its
+    // points through a factory of its own.
+    std::vector<geos::geom::GeometryFactory::Ptr> _thread_factories;
+
+    // Bounding box and size of the loaded geometry.
+    geos::geom::Envelope _extent;
+    size_t _n_geometries = 0;
+
 public:
-    GeosIndexExperimentRunner(std::string name, std::string crs, std::string executable_name) : BaseExperimentRunner<TIndex, std::unique_ptr<geos::geom::Point>, GeosDistanceQuery, GeosRangeQuery>(name, executable_name), _transformer("EPSG:4326", crs)
+    GeosExperimentRunner(std::string name, std::string crs) : BaseExperimentRunner<TIndex, TGeom, GeosDistanceQuery, GeosRangeQuery, GeosKnnQuery>(name), _projector("EPSG:4326", crs)
     {
         _factory = geos::geom::GeometryFactory::create();
+
+        for (unsigned int t = 0; t < _projector.n_threads(); t++)
+        {
+            _thread_factories.push_back(geos::geom::GeometryFactory::create());
+        }
     };
 
+protected:
+    // New point for an insert or move: the anchor point offset by the update, as the projected CRS is in meters.
+    std::unique_ptr<geos::geom::Point> displaced_point(const std::vector<std::unique_ptr<geos::geom::Point>> &geometry, const PointUpdate &update) const
+    {
+        const auto &anchor = geometry[update.anchor];
+        return _factory->createPoint(geos::geom::Coordinate(anchor->getX() + update.dx, anchor->getY() + update.dy));
+    }
+
+    geos::geom::Envelope displaced_point(const std::vector<geos::geom::Envelope> &geometry, const PointUpdate &update) const
+    {
+        const auto &anchor = geometry[update.anchor];
+        return geos::geom::Envelope(anchor.getMinX() + update.dx, anchor.getMinX() + update.dx, anchor.getMinY() + update.dy, anchor.getMinY() + update.dy);
+    }
+
 private:
-    std::vector<std::unique_ptr<geos::geom::Point>> load_geometry(std::string file_path, std::function<void(size_t, size_t)> progress)
+    void make_point(std::unique_ptr<geos::geom::Point> &point, double x, double y, unsigned int thread_id)
+    {
+        point = _thread_factories[thread_id]->createPoint(geos::geom::Coordinate(x, y));
+    }
+
+    void make_point(geos::geom::Envelope &point, double x, double y, unsigned int thread_id)
+    {
+        point.init(x, x, y, y);
+    }
+
+    std::vector<TGeom> load_geometry(std::string file_path, std::function<void(size_t, size_t)> progress)
     {
-        auto coordinates = load_coordinates(file_path);
-        std::vector<std::unique_ptr<geos::geom::Point>> geos_points;
+        CoordinateFile coordinates(file_path);
+        auto span = coordinates.span();
 
-        for (size_t i = 0; i < coordinates.size(); i++)
+        std::vector<TGeom> geos_points(span.size());
+        std::vector<geos::geom::Envelope> thread_extents(_projector.n_threads());
+
+        _projector.transform(
+            span.size(),
+            [&span](size_t i) { return span[i]; },
+            [&](size_t i, double x, double y, unsigned int thread_id) {
+                make_point(geos_points[i], x, y, thread_id);
+                thread_extents[thread_id].expandToInclude(x, y);
+            },
+            progress);
+
+        _extent = geos::geom::Envelope();
+        _n_geometries = geos_points.size();
+
+        for (const auto &extent : thread_extents)
         {
-            auto latlon = coordinates[i];
-            auto xy = _transformer.transform(latlon.lat, latlon.lon);
-            geos_points.push_back(_factory->createPoint(geos::geom::Coordinate(std::get<0>(xy), std::get<1>(xy))));
-            progress(i, coordinates.size());
+            _extent.expandToInclude(&extent);
         }
 
         return geos_points;
@@ -47,15 +105,23 @@ private:
     {
         auto raw_queries = _load_distance_queries(file_path);
 
+        std::vector<double> xs(raw_queries.size());
+        std::vector<double> ys(raw_queries.size());
+
+        _projector.transform(
+            raw_queries.size(),
+            [&raw_queries](size_t i) { return raw_queries[i].coord; },
+            [&](size_t i, double x, double y, unsigned int thread_id) {
+                xs[i] = x;
+                ys[i] = y;
+            });
+
         std::vector<GeosDistanceQuery> queries;
+        queries.reserve(raw_queries.size());
 
         for (size_t i = 0; i < raw_queries.size(); i++)
         {
-            auto q = raw_queries[i];
-            auto xy = _transformer.transform(q.coord.lat, q.coord.lon);
-
-            queries.push_back({_factory->createPoint(geos::geom::Coordinate(std::get<0>(xy), std::get<1>(xy))), q.distance});
-
+            queries.push_back({_factory->createPoint(geos::geom::Coordinate(xs[i], ys[i])), raw_queries[i].distance});
             progress(i, raw_queries.size());
         }
 
@@ -66,103 +132,288 @@ private:
     {
         auto raw_queries = _load_range_queries(file_path);
 
+        // Corner a of query i is stored at 2 * i, corner b at 2 * i + 1.
+        std::vector<double> xs(2 * raw_queries.size());
+        std::vector<double> ys(2 * raw_queries.size());
+
+        _projector.transform(
+            2 * raw_queries.size(),
+            [&raw_queries](size_t i) { return i % 2 == 0 ? raw_queries[i / 2].a : raw_queries[i / 2].b; },
+            [&](size_t i, double x, double y, unsigned int thread_id) {
+                xs[i] = x;
+                ys[i] = y;
+            });
+
         std::vector<GeosRangeQuery> queries;
+        queries.reserve(raw_queries.size());
 
         for (size_t i = 0; i < raw_queries.size(); i++)
         {
-            auto q = raw_queries[i];
+            queries.push_back({geos::geom::Envelope(geos::geom::Coordinate(xs[2 * i], ys[2 * i]),
+                                                    geos::geom::Coordinate(xs[2 * i + 1], ys[2 * i + 1]))});
+            progress(i, raw_queries.size());
+        }
 
-            auto xya = _transformer.transform(q.a.lat, q.a.lon);
-            auto xa = std::get<0>(xya);
-            auto ya = std::get<1>(xya);
+        return queries;
+    }
+
+    // Batches are sorted along a Hilbert curve over the extent of the geometry.
+    uint64_t hilbert_key(double x, double y) const
+    {
+        if (_extent.isNull())
+        {
+            return 0;
+        }
 
-            auto xyb = _transformer.transform(q.b.lat, q.b.lon);
-            auto xb = std::get<0>(xyb);
-            auto yb = std::get<1>(xyb);
+        return HilbertMapper(_extent.getMinX(), _extent.getMinY(), _extent.getMaxX(), _extent.getMaxY())(x, y);
+    }
 
-            queries.push_back({geos::geom::Envelope(geos::geom::Coordinate(xa, ya),
-                                                    geos::geom::Coordinate(xb, yb))});
+    uint64_t locality_key(const GeosDistanceQuery &query)
+    {
+        return hilbert_key(query.point->getX(), query.point->getY());
+    }
+
+    uint64_t locality_key(const GeosRangeQuery &query)
+    {
+        return hilbert_key((query.range.getMinX() + query.range.getMaxX()) / 2, (query.range.getMinY() + query.range.getMaxY()) / 2);
+    }
+
+    uint64_t locality_key(const GeosKnnQuery &query)
+    {
+        return hilbert_key(query.point->getX(), query.point->getY());
+    }
+
+    std::vector<GeosKnnQuery> load_knn_queries(std::string file_path, std::function<void(size_t, size_t)> progress)
+    {
+        auto raw_queries = _load_knn_queries(file_path);
+
+        std::vector<double> xs(raw_queries.size());
+        std::vector<double> ys(raw_queries.size());
+
+        _projector.transform(
+            raw_queries.size(),
+            [&raw_queries](size_t i) { return raw_queries[i].coord; },
+            [&](size_t i, double x, double y, unsigned int thread_id) {
+                xs[i] = x;
+                ys[i] = y;
+            });
+
+        std::vector<GeosKnnQuery> queries;
+        queries.reserve(raw_queries.size());
+
+        for (size_t i = 0; i < raw_queries.size(); i++)
+        {
+            queries.push_back({_factory->createPoint(geos::geom::Coordinate(xs[i], ys[i]))});
             progress(i, raw_queries.size());
         }
 
         return queries;
     }
+};
+
+// Item of point id in a GEOS index over point handles. Ids are offset by one, so that no item is a null pointer.
+inline void *point_handle(size_t id)
+{
+    return reinterpret_cast<void *>(static_cast<uintptr_t>(id) + 1);
+}
+
+inline size_t point_handle_id(const void *item)
+{
+    return reinterpret_cast<uintptr_t>(item) - 1;
+}
+
+// Candidate coordinates gathered as structure-of-arrays for the refinement kernels in utils/refine.h.
+struct GeosCandidateBuffer
+{
+    std::vector<void *> items;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<uint64_t> mask;
+
+    // Items are geos::geom::Point instances.
+    void gather()
+    {
+        x.resize(items.size());
+        y.resize(items.size());
+        mask.resize(refine_mask_words(items.size()));
+
+        for (size_t j = 0; j < items.size(); j++)
+        {
+            auto point = static_cast<geos::geom::Point *>(items[j]);
+            x[j] = point->getX();
+            y[j] = point->getY();
+        }
+    }
+
+    // Items are point handles into points. A stale index can still return handles of removed points, whose null
+    // envelopes have no coordinates to refine on, so those are dropped.
+    void gather(const std::vector<geos::geom::Envelope> &points)
+    {
+        size_t n = 0;
+
+        x.resize(items.size());
+        y.resize(items.size());
+
+        for (size_t j = 0; j < items.size(); j++)
+        {
+            const auto &point = points[point_handle_id(items[j])];
+
+            if (!point.isNull())
+            {
+                items[n] = items[j];
+                x[n] = point.getMinX();
+                y[n] = point.getMinY();
+                n++;
+            }
+        }
+
+        items.resize(n);
+        x.resize(n);
+        y.resize(n);
+        mask.resize(refine_mask_words(n));
+    }
+};
+
+// Runs the queries against a GEOS SpatialIndex and refines the candidates with the vectorized kernels.
+template <typename TIndex, typename TGeom = std::unique_ptr<geos::geom::Point>>
+class GeosIndexExperimentRunner : public GeosExperimentRunner<TIndex, TGeom>
+{
+public:
+    GeosIndexExperimentRunner(std::string name, std::string crs) : GeosExperimentRunner<TIndex, TGeom>(name, crs){};
 
-    void execute_distance_queries(TIndex *index, std::vector<GeosDistanceQuery> &queries, std::function<void(size_t, size_t)> progress)
+protected:
+    // Read the coordinates of the candidate items, which are geos::geom::Point instances unless overridden.
+    virtual void gather(TIndex *index, GeosCandidateBuffer &candidates)
     {
-        // Run for at most 2 minutes to prevent excessive compute usage. This should be enough to get an approximate throughput.
-        int max_seconds = 2 * 60;
-        auto start_time = std::chrono::high_resolution_clock::now();
+        candidates.gather();
+    }
+
+private:
+    void execute_distance_queries(TIndex *index, QuerySlice<GeosDistanceQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        // Buffers are local to the call, as executors run concurrently.
+        std::vector<void *> result;
+        GeosCandidateBuffer candidates;
 
         for (size_t i = 0; i < queries.size(); i++)
         {
+            auto query_start = std::chrono::steady_clock::now();
+
             auto target_point = queries[i].point.get();
             auto distance = queries[i].distance;
 
             geos::geom::Envelope rectangle(geos::geom::Coordinate(target_point->getX() - distance, target_point->getY() - distance),
                                            geos::geom::Coordinate(target_point->getX() + distance, target_point->getY() + distance));
 
-            std::vector<geos::geom::Point *> result;
-            std::vector<void *> candidates;
+            result.clear();
+            candidates.items.clear();
+            index->query(&rectangle, candidates.items);
 
-            index->query(&rectangle, candidates);
+            gather(index, candidates);
+            refine_distance(candidates.x.data(), candidates.y.data(), candidates.items.size(), target_point->getX(), target_point->getY(), distance * distance, candidates.mask.data());
 
-            for (const auto &candidate : candidates)
-            {
-                auto point = static_cast<geos::geom::Point *>(candidate);
-                if (point->isWithinDistance(target_point, distance))
-                {
-                    result.push_back(point);
-                }
-            }
+            for_each_match(candidates.mask.data(), candidates.items.size(), [&](size_t j) {
+                result.push_back(candidates.items[j]);
+            });
 
-            auto current_time = std::chrono::high_resolution_clock::now();
-            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
 
             progress(i, queries.size());
+        }
+    }
 
-            if (seconds >= max_seconds)
+    void execute_range_queries(TIndex *index, QuerySlice<GeosRangeQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        // Buffers are local to the call, as executors run concurrently.
+        std::vector<void *> result;
+        GeosCandidateBuffer candidates;
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            const auto &range = queries[i].range;
+
+            result.clear();
+            candidates.items.clear();
+            index->query(&range, candidates.items);
+
+            gather(index, candidates);
+            refine_range(candidates.x.data(), candidates.y.data(), candidates.items.size(), range.getMinX(), range.getMinY(), range.getMaxX(), range.getMaxY(), candidates.mask.data());
+
+            for_each_match(candidates.mask.data(), candidates.items.size(), [&](size_t j) {
+                result.push_back(candidates.items[j]);
+            });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+protected:
+    // Push the k nearest points into the heap by querying a square window around (x, y). The window starts at the
+    // size that holds k points at the mean density and grows until k points lie within its inscribed circle.
+    void query_knn_window(TIndex *index, double x, double y, GeosCandidateBuffer &candidates, KnnHeap<void *> &heap)
+    {
+        double area = this->_extent.isNull() ? 0 : this->_extent.getWidth() * this->_extent.getHeight();
+        double radius = std::max(1.0, 0.5 * std::sqrt(heap.k() * area / std::max<size_t>(1, this->_n_geometries)));
+
+        while (true)
+        {
+            geos::geom::Envelope window(x - radius, x + radius, y - radius, y + radius);
+
+            candidates.items.clear();
+            index->query(&window, candidates.items);
+            gather(index, candidates);
+
+            heap.clear();
+
+            for (size_t j = 0; j < candidates.items.size(); j++)
+            {
+                double dx = candidates.x[j] - x;
+                double dy = candidates.y[j] - y;
+                heap.push(dx * dx + dy * dy, candidates.items[j]);
+            }
+
+            if ((heap.full() && heap.bound() <= radius * radius) || this->_extent.isNull() || window.covers(&this->_extent))
             {
-                break;
+                return;
             }
+
+            // With k candidates in hand, their farthest distance bounds the final radius. It is rounded up, so that the
+            // next window is the last even if squaring the root rounds down.
+            radius = heap.full() ? std::nextafter(std::sqrt(heap.bound()), std::numeric_limits<double>::infinity()) : 2 * radius;
         }
     }
 
-    void execute_range_queries(TIndex *index, std::vector<GeosRangeQuery> &queries, std::function<void(size_t, size_t)> progress)
+    // Protected so that runners with a native nearest-neighbour search can fall back to the window search.
+    void execute_knn_queries(TIndex *index, QuerySlice<GeosKnnQuery> queries, size_t k, LatencyHistogram &latencies, ProgressCounter &progress)
     {
-        std::vector<geos::geom::Geometry *> result;
-        result.reserve(1e8);
-
-        // Run for at most 2 minutes to prevent excessive compute usage. This should be enough to get an approximate throughput.
-        int max_seconds = 2 * 60;
-        auto start_time = std::chrono::high_resolution_clock::now();
+        std::vector<void *> result;
+        GeosCandidateBuffer candidates;
+        KnnHeap<void *> heap(k);
 
         for (size_t i = 0; i < queries.size(); i++)
         {
-            std::vector<geos::geom::Point *> result;
-            std::vector<void *> candidates;
+            auto query_start = std::chrono::steady_clock::now();
+
+            auto target_point = queries[i].point.get();
 
-            index->query(&queries[i].range, candidates);
-            auto target_range = _factory->toGeometry(&queries[i].range);
+            result.clear();
+            query_knn_window(index, target_point->getX(), target_point->getY(), candidates, heap);
 
-            for (const auto &candidate : candidates)
+            for (const auto &neighbour : heap.sorted())
             {
-                auto point = static_cast<geos::geom::Point *>(candidate);
-                if (point->within(target_range.get()))
-                {
-                    result.push_back(point);
-                }
+                result.push_back(neighbour.second);
             }
 
-            auto current_time = std::chrono::high_resolution_clock::now();
-            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
 
             progress(i, queries.size());
-
-            if (seconds >= max_seconds)
-            {
-                break;
-            }
         }
     }
 };
\ No newline at end of file
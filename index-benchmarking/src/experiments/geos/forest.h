@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include "geos/index/strtree/STRtree.h"
+#include "geos/index/quadtree/Quadtree.h"
+#include "../../indexes/index_forest.h"
+#include "../../utils/parallel.h"
+#include "common.h"
+
+// Completes a GEOS index once all points were inserted. STRtree packs its nodes on the first query otherwise, which
+// would be charged to the query timings.
+inline void finish_geos_index(geos::index::strtree::STRtree &index)
+{
+    index.build();
+}
+
+inline void finish_geos_index(geos::index::quadtree::Quadtree &index) {}
+
+// Parallel bulk load of a GEOS index, see IndexForest. Queries run through the same executors as the serially built
+// STRtree and Quadtree runners, so the build times of both can be compared directly.
+template <typename TIndex>
+class IndexForestExperimentRunner : public GeosIndexExperimentRunner<IndexForest<TIndex>>
+{
+private:
+    unsigned int _n_partitions;
+
+public:
+    IndexForestExperimentRunner(std::string name, std::string crs, unsigned int n_partitions = hardware_threads()) : GeosIndexExperimentRunner<IndexForest<TIndex>>(name, crs), _n_partitions(n_partitions) {}
+
+private:
+    std::unique_ptr<IndexForest<TIndex>> build_index(std::vector<std::unique_ptr<geos::geom::Point>> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        return std::make_unique<IndexForest<TIndex>>(geometry, _n_partitions, [](TIndex &tree) { finish_geos_index(tree); }, progress);
+    }
+
+    std::vector<std::pair<std::string, std::string>> index_properties(IndexForest<TIndex> *index)
+    {
+        return {
+            {"n_partitions", std::to_string(index->n_partitions())},
+            {"max_partition_size", std::to_string(index->max_partition_size())},
+        };
+    }
+};
+
+typedef IndexForestExperimentRunner<geos::index::strtree::STRtree> ParallelSTRtreeExperimentRunner;
+typedef IndexForestExperimentRunner<geos::index::quadtree::Quadtree> ParallelQuadtreeExperimentRunner;
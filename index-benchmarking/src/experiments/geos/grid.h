@@ -0,0 +1,123 @@
+#pragma once
+#include <string>
+#include "../../indexes/grid_index.h"
+#include "common.h"
+
+class GridExperimentRunner : public GeosExperimentRunner<GridIndex>
+{
+private:
+    bool _two_level;
+
+public:
+    // The cell size is tuned to the point density and the selectivity of the query files of each run. With
+    // two_level set, heavy cells are split into a second level.
+    GridExperimentRunner(std::string name, std::string crs, bool two_level = true) : GeosExperimentRunner<GridIndex>(name, crs), _two_level(two_level) {}
+
+private:
+    std::unique_ptr<GridIndex> build_index(std::vector<std::unique_ptr<geos::geom::Point>> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        std::vector<double> x(geometry.size());
+        std::vector<double> y(geometry.size());
+
+        for (size_t i = 0; i < geometry.size(); i++)
+        {
+            x[i] = geometry[i]->getX();
+            y[i] = geometry[i]->getY();
+            progress(i, geometry.size());
+        }
+
+        double cell_size = GridIndex::tune_cell_size(x.data(), y.data(), geometry.size(), _query_selectivities);
+        return std::make_unique<GridIndex>(x.data(), y.data(), geometry.size(), cell_size, _two_level);
+    }
+
+    size_t index_structural_bytes(GridIndex *index)
+    {
+        return index->bytes();
+    }
+
+    std::vector<std::pair<std::string, std::string>> index_properties(GridIndex *index)
+    {
+        return {
+            {"cell_size", std::to_string(index->cell_size()) + " m"},
+            {"n_cells", std::to_string(index->n_cells())},
+            {"n_split_cells", std::to_string(index->n_split_cells())},
+        };
+    }
+
+    size_t save_index(GridIndex *index, std::string file_path)
+    {
+        return save_snapshot(*index, file_path);
+    }
+
+    std::unique_ptr<GridIndex> load_index(std::string file_path)
+    {
+        return load_snapshot<GridIndex>(file_path);
+    }
+
+    void execute_distance_queries(GridIndex *index, QuerySlice<GeosDistanceQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        std::vector<uint32_t> result;
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            auto target_point = queries[i].point.get();
+
+            result.clear();
+            index->query_distance(target_point->getX(), target_point->getY(), queries[i].distance, [&result](uint32_t id) { result.push_back(id); });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+    void execute_range_queries(GridIndex *index, QuerySlice<GeosRangeQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        std::vector<uint32_t> result;
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            const auto &range = queries[i].range;
+
+            result.clear();
+            index->query_range(range.getMinX(), range.getMinY(), range.getMaxX(), range.getMaxY(), [&result](uint32_t id) { result.push_back(id); });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+    void execute_knn_queries(GridIndex *index, QuerySlice<GeosKnnQuery> queries, size_t k, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        std::vector<uint32_t> result;
+        KnnHeap<uint32_t> heap(k);
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            auto target_point = queries[i].point.get();
+
+            result.clear();
+            heap.clear();
+            index->query_knn(target_point->getX(), target_point->getY(), heap);
+
+            for (const auto &neighbour : heap.sorted())
+            {
+                result.push_back(neighbour.second);
+            }
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include "geos/index/strtree/STRtree.h"
+#include "geos/index/quadtree/Quadtree.h"
+#include "common.h"
+
+// GEOS index over point handles instead of geos::geom::Point instances. The loaded geometry is one contiguous array
+// with a degenerate envelope per point, which is what the index is given, and items are point_handle(id). The array
+// doubles as the coordinates for refinement, and outlives the index in run(), as older GEOS versions of STRtree keep
+// a pointer to every inserted envelope.
+template <typename TTree>
+struct GeosHandleIndex
+{
+    TTree tree;
+    const std::vector<geos::geom::Envelope> *points;
+
+    GeosHandleIndex(const std::vector<geos::geom::Envelope> &points) : points(&points) {}
+
+    inline void query(const geos::geom::Envelope *envelope, std::vector<void *> &items)
+    {
+        tree.query(envelope, items);
+    }
+};
+
+// Removed points are null envelopes in the geometry.
+template <typename TTree>
+class GeosHandleExperimentRunner : public GeosIndexExperimentRunner<GeosHandleIndex<TTree>, geos::geom::Envelope>
+{
+public:
+    GeosHandleExperimentRunner(std::string name, std::string crs) : GeosIndexExperimentRunner<GeosHandleIndex<TTree>, geos::geom::Envelope>(name, crs) {}
+
+protected:
+    std::unique_ptr<GeosHandleIndex<TTree>> insert_points(std::vector<geos::geom::Envelope> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        auto index = std::make_unique<GeosHandleIndex<TTree>>(geometry);
+
+        for (size_t i = 0; i < geometry.size(); i++)
+        {
+            if (!geometry[i].isNull())
+            {
+                index->tree.insert(&geometry[i], point_handle(i));
+            }
+
+            progress(i, geometry.size());
+        }
+
+        return index;
+    }
+
+    void gather(GeosHandleIndex<TTree> *index, GeosCandidateBuffer &candidates)
+    {
+        candidates.gather(*index->points);
+    }
+
+    bool supports_updates()
+    {
+        return true;
+    }
+};
+
+// STRtreeExperimentRunner over point handles, rebuilt under updates in the same way. The k = 1 queries use the window
+// search, as the native nearest-neighbour search computes distances between geometries.
+class STRtreeHandleExperimentRunner : public GeosHandleExperimentRunner<geos::index::strtree::STRtree>
+{
+private:
+    double _rebuild_fraction;
+    size_t _pending_updates = 0;
+
+public:
+    STRtreeHandleExperimentRunner(std::string name, std::string crs, double rebuild_fraction = 0.01) : GeosHandleExperimentRunner<geos::index::strtree::STRtree>(name, crs), _rebuild_fraction(rebuild_fraction) {}
+
+private:
+    std::unique_ptr<GeosHandleIndex<geos::index::strtree::STRtree>> build_index(std::vector<geos::geom::Envelope> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        auto index = insert_points(geometry, progress);
+        index->tree.build();
+
+        _pending_updates = 0;
+
+        return index;
+    }
+
+    // Points are updated in place, so queries on the stale tree refine on the current coordinates and skip the
+    // handles of removed points.
+    void apply_update(std::unique_ptr<GeosHandleIndex<geos::index::strtree::STRtree>> &index, std::vector<geos::geom::Envelope> &geometry, const PointUpdate &update)
+    {
+        auto point = update.kind == PointUpdate::REMOVE ? geos::geom::Envelope() : this->displaced_point(geometry, update);
+        geometry[update.id] = point;
+
+        if (++_pending_updates >= std::max(1.0, _rebuild_fraction * geometry.size()))
+        {
+            index = build_index(geometry, [](size_t i, size_t n) {});
+        }
+    }
+};
+
+// QuadtreeExperimentRunner over point handles, updated in place.
+class QuadtreeHandleExperimentRunner : public GeosHandleExperimentRunner<geos::index::quadtree::Quadtree>
+{
+public:
+    QuadtreeHandleExperimentRunner(std::string name, std::string crs) : GeosHandleExperimentRunner<geos::index::quadtree::Quadtree>(name, crs) {}
+
+private:
+    std::unique_ptr<GeosHandleIndex<geos::index::quadtree::Quadtree>> build_index(std::vector<geos::geom::Envelope> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        return insert_points(geometry, progress);
+    }
+
+    void apply_update(std::unique_ptr<GeosHandleIndex<geos::index::quadtree::Quadtree>> &index, std::vector<geos::geom::Envelope> &geometry, const PointUpdate &update)
+    {
+        if (update.kind != PointUpdate::INSERT)
+        {
+            index->tree.remove(&geometry[update.id], point_handle(update.id));
+        }
+
+        if (update.kind == PointUpdate::REMOVE)
+        {
+            geometry[update.id].setToNull();
+            return;
+        }
+
+        geometry[update.id] = this->displaced_point(geometry, update);
+        index->tree.insert(&geometry[update.id], point_handle(update.id));
+    }
+};
@@ -0,0 +1,126 @@
+#pragma once
+#include "../../indexes/lsm_index.h"
+#include "common.h"
+
+class LsmExperimentRunner : public GeosExperimentRunner<LsmPointIndex>
+{
+private:
+    size_t _buffer_capacity;
+    size_t _size_ratio;
+
+public:
+    LsmExperimentRunner(std::string name, std::string crs, size_t buffer_capacity = LsmPointIndex::DEFAULT_BUFFER_CAPACITY, size_t size_ratio = LsmPointIndex::DEFAULT_SIZE_RATIO) : GeosExperimentRunner<LsmPointIndex>(name, crs), _buffer_capacity(buffer_capacity), _size_ratio(size_ratio) {}
+
+private:
+    std::unique_ptr<LsmPointIndex> build_index(std::vector<std::unique_ptr<geos::geom::Point>> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        std::vector<double> x(geometry.size());
+        std::vector<double> y(geometry.size());
+
+        for (size_t i = 0; i < geometry.size(); i++)
+        {
+            x[i] = geometry[i]->getX();
+            y[i] = geometry[i]->getY();
+            progress(i, geometry.size());
+        }
+
+        return std::make_unique<LsmPointIndex>(x.data(), y.data(), geometry.size(), _buffer_capacity, _size_ratio);
+    }
+
+    size_t index_structural_bytes(LsmPointIndex *index)
+    {
+        return index->bytes();
+    }
+
+    std::vector<std::pair<std::string, std::string>> index_properties(LsmPointIndex *index)
+    {
+        return {
+            {"buffer_capacity", std::to_string(index->buffer_capacity())},
+            {"size_ratio", std::to_string(index->size_ratio())},
+        };
+    }
+
+    bool supports_updates()
+    {
+        return true;
+    }
+
+    void apply_update(std::unique_ptr<LsmPointIndex> &index, std::vector<std::unique_ptr<geos::geom::Point>> &geometry, const PointUpdate &update)
+    {
+        if (update.kind == PointUpdate::REMOVE)
+        {
+            index->remove(update.id);
+            geometry[update.id].reset();
+            return;
+        }
+
+        geometry[update.id] = this->displaced_point(geometry, update);
+        index->insert(update.id, geometry[update.id]->getX(), geometry[update.id]->getY());
+    }
+
+    void execute_distance_queries(LsmPointIndex *index, QuerySlice<GeosDistanceQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        std::vector<uint32_t> result;
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            auto target_point = queries[i].point.get();
+
+            result.clear();
+            index->query_distance(target_point->getX(), target_point->getY(), queries[i].distance, [&result](uint32_t id) { result.push_back(id); });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+    void execute_range_queries(LsmPointIndex *index, QuerySlice<GeosRangeQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        std::vector<uint32_t> result;
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            const auto &range = queries[i].range;
+
+            result.clear();
+            index->query_range(range.getMinX(), range.getMinY(), range.getMaxX(), range.getMaxY(), [&result](uint32_t id) { result.push_back(id); });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+    void execute_knn_queries(LsmPointIndex *index, QuerySlice<GeosKnnQuery> queries, size_t k, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        std::vector<uint32_t> result;
+        KnnHeap<uint32_t> heap(k);
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            auto target_point = queries[i].point.get();
+
+            result.clear();
+            index->query_knn(target_point->getX(), target_point->getY(), heap);
+
+            for (const auto &neighbour : heap.sorted())
+            {
+                result.push_back(neighbour.second);
+            }
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+};
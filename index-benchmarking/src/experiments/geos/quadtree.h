@@ -5,7 +5,7 @@
 class QuadtreeExperimentRunner : public GeosIndexExperimentRunner<geos::index::quadtree::Quadtree>
 {
 public:
-    QuadtreeExperimentRunner(std::string name, std::string crs, std::string executable_name) : GeosIndexExperimentRunner<geos::index::quadtree::Quadtree>(name, crs, executable_name) {}
+    QuadtreeExperimentRunner(std::string name, std::string crs) : GeosIndexExperimentRunner<geos::index::quadtree::Quadtree>(name, crs) {}
 
 private:
     std::unique_ptr<geos::index::quadtree::Quadtree> build_index(std::vector<std::unique_ptr<geos::geom::Point>> &geometry, std::function<void(size_t, size_t)> progress)
@@ -20,4 +20,28 @@ private:
 
         return index;
     }
+
+    bool supports_updates()
+    {
+        return true;
+    }
+
+    // The quadtree is updated in place. A removed point is released once it is out of the tree.
+    void apply_update(std::unique_ptr<geos::index::quadtree::Quadtree> &index, std::vector<std::unique_ptr<geos::geom::Point>> &geometry, const PointUpdate &update)
+    {
+        if (update.kind != PointUpdate::INSERT)
+        {
+            index->remove(geometry[update.id]->getEnvelopeInternal(), geometry[update.id].get());
+        }
+
+        if (update.kind == PointUpdate::REMOVE)
+        {
+            geometry[update.id].reset();
+            return;
+        }
+
+        auto point = this->displaced_point(geometry, update);
+        index->insert(point->getEnvelopeInternal(), point.get());
+        geometry[update.id] = std::move(point);
+    }
 };
\ No newline at end of file
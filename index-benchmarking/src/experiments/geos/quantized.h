@@ -0,0 +1,126 @@
+#pragma once
+#include "../../indexes/quantized_rtree.h"
+#include "common.h"
+
+// Exact coordinates of the loaded points, read by the quantized index for refinement near query boundaries.
+struct GeosPointSource
+{
+    const std::vector<std::unique_ptr<geos::geom::Point>> *geometry;
+
+    inline double x(uint32_t id) const
+    {
+        return (*geometry)[id]->getX();
+    }
+
+    inline double y(uint32_t id) const
+    {
+        return (*geometry)[id]->getY();
+    }
+};
+
+typedef QuantizedRTree<GeosPointSource> GeosQuantizedRTree;
+
+class QuantizedRTreeExperimentRunner : public GeosExperimentRunner<GeosQuantizedRTree>
+{
+private:
+    PackedRTree::SortOrder _sort_order;
+
+public:
+    QuantizedRTreeExperimentRunner(std::string name, std::string crs, PackedRTree::SortOrder sort_order = PackedRTree::STR) : GeosExperimentRunner<GeosQuantizedRTree>(name, crs), _sort_order(sort_order) {}
+
+private:
+    // The index keeps reading the geometry, which outlives it in run().
+    std::unique_ptr<GeosQuantizedRTree> build_index(std::vector<std::unique_ptr<geos::geom::Point>> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        std::vector<double> x(geometry.size());
+        std::vector<double> y(geometry.size());
+
+        for (size_t i = 0; i < geometry.size(); i++)
+        {
+            x[i] = geometry[i]->getX();
+            y[i] = geometry[i]->getY();
+            progress(i, geometry.size());
+        }
+
+        return std::make_unique<GeosQuantizedRTree>(GeosPointSource{&geometry}, x.data(), y.data(), geometry.size(), _sort_order);
+    }
+
+    size_t index_structural_bytes(GeosQuantizedRTree *index)
+    {
+        return index->bytes();
+    }
+
+    std::vector<std::pair<std::string, std::string>> index_properties(GeosQuantizedRTree *index)
+    {
+        return {
+            {"quantum", std::to_string(index->quantum()) + " m"},
+        };
+    }
+
+    void execute_distance_queries(GeosQuantizedRTree *index, QuerySlice<GeosDistanceQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        std::vector<uint32_t> result;
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            auto target_point = queries[i].point.get();
+
+            result.clear();
+            index->query_distance(target_point->getX(), target_point->getY(), queries[i].distance, [&result](uint32_t id) { result.push_back(id); });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+    void execute_range_queries(GeosQuantizedRTree *index, QuerySlice<GeosRangeQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        std::vector<uint32_t> result;
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            const auto &range = queries[i].range;
+
+            result.clear();
+            index->query_range(range.getMinX(), range.getMinY(), range.getMaxX(), range.getMaxY(), [&result](uint32_t id) { result.push_back(id); });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+    void execute_knn_queries(GeosQuantizedRTree *index, QuerySlice<GeosKnnQuery> queries, size_t k, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        std::vector<uint32_t> result;
+        KnnHeap<uint32_t> heap(k);
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            auto target_point = queries[i].point.get();
+
+            result.clear();
+            heap.clear();
+            index->query_knn(target_point->getX(), target_point->getY(), heap);
+
+            for (const auto &neighbour : heap.sorted())
+            {
+                result.push_back(neighbour.second);
+            }
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+};
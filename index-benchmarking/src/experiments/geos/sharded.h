@@ -0,0 +1,87 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include "../../indexes/sharded_index.h"
+#include "../../utils/threadpool.h"
+#include "forest.h"
+#include "common.h"
+
+// ShardedIndex of GEOS indexes behind the query of a single tree, so the generic GEOS executors run on it unchanged.
+template <typename TIndex>
+class GeosShardedIndex : public ShardedIndex<TIndex, geos::geom::Envelope>
+{
+public:
+    using ShardedIndex<TIndex, geos::geom::Envelope>::ShardedIndex;
+
+    // Appends the candidates of every shard whose bounding box intersects the search envelope, in shard order.
+    void query(const geos::geom::Envelope *search_envelope, std::vector<void *> &items) const
+    {
+        std::vector<std::vector<void *>> found(this->n_shards());
+
+        this->fan_out([search_envelope](const geos::geom::Envelope &bounds) { return bounds.intersects(search_envelope); },
+                      [&found, search_envelope](TIndex &shard, size_t s) { shard.query(search_envelope, found[s]); });
+
+        for (const auto &shard_items : found)
+        {
+            items.insert(items.end(), shard_items.begin(), shard_items.end());
+        }
+    }
+};
+
+// Splits the points into n_shards rectangles of equal size with a k-d split and builds one GEOS index per shard in
+// parallel. Shard searches run on a thread pool of the index, created with it so that its threads are counted by the
+// hardware counters of the run.
+template <typename TIndex>
+class ShardedGeosExperimentRunner : public GeosIndexExperimentRunner<GeosShardedIndex<TIndex>>
+{
+private:
+    unsigned int _n_shards;
+
+public:
+    ShardedGeosExperimentRunner(std::string name, std::string crs, unsigned int n_shards = hardware_threads()) : GeosIndexExperimentRunner<GeosShardedIndex<TIndex>>(name, crs), _n_shards(n_shards) {}
+
+private:
+    std::unique_ptr<GeosShardedIndex<TIndex>> build_index(std::vector<std::unique_ptr<geos::geom::Point>> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        std::vector<double> x(geometry.size());
+        std::vector<double> y(geometry.size());
+
+        for (size_t i = 0; i < geometry.size(); i++)
+        {
+            x[i] = geometry[i]->getX();
+            y[i] = geometry[i]->getY();
+        }
+
+        auto layout = kd_shard_layout(x.data(), y.data(), geometry.size(), _n_shards);
+        std::atomic<size_t> done(0);
+
+        return std::make_unique<GeosShardedIndex<TIndex>>(layout, std::make_shared<ThreadPool>(), [&](const uint32_t *ids, size_t n, geos::geom::Envelope &bounds) {
+            auto index = std::make_unique<TIndex>();
+
+            for (size_t j = 0; j < n; j++)
+            {
+                const auto &point = geometry[ids[j]];
+                index->insert(point->getEnvelopeInternal(), point.get());
+                bounds.expandToInclude(x[ids[j]], y[ids[j]]);
+
+                if (j % (1 << 14) == 0)
+                {
+                    progress(done += std::min<size_t>(1 << 14, n - j), geometry.size());
+                }
+            }
+
+            finish_geos_index(*index);
+            return index;
+        });
+    }
+
+    std::vector<std::pair<std::string, std::string>> index_properties(GeosShardedIndex<TIndex> *index)
+    {
+        return {
+            {"n_shards", std::to_string(index->n_shards())},
+            {"max_shard_size", std::to_string(index->max_shard_size())},
+        };
+    }
+};
+
+typedef ShardedGeosExperimentRunner<geos::index::strtree::STRtree> ShardedSTRtreeExperimentRunner;
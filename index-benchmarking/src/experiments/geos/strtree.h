@@ -1,24 +1,93 @@
 #pragma once
 #include "geos/index/strtree/STRtree.h"
+#include "geos/index/strtree/GeometryItemDistance.h"
 #include "common.h"
 
+// An STRtree cannot change once built, so under updates it is rebuilt from the current geometry as soon as the
+// updates since the last build reach rebuild_fraction of the points. Queries in between run on the stale tree.
 class STRtreeExperimentRunner : public GeosIndexExperimentRunner<geos::index::strtree::STRtree>
 {
+private:
+    double _rebuild_fraction;
+    size_t _pending_updates = 0;
+
+    // Points replaced or removed since the last build, kept alive for the stale tree that still refers to them.
+    std::vector<std::unique_ptr<geos::geom::Point>> _retired;
+
 public:
-    STRtreeExperimentRunner(std::string name, std::string crs, std::string executable_name) : GeosIndexExperimentRunner<geos::index::strtree::STRtree>(name, crs, executable_name) {}
+    STRtreeExperimentRunner(std::string name, std::string crs, double rebuild_fraction = 0.01) : GeosIndexExperimentRunner<geos::index::strtree::STRtree>(name, crs), _rebuild_fraction(rebuild_fraction) {}
 
 private:
+    // Removed points are null in the geometry and left out.
     std::unique_ptr<geos::index::strtree::STRtree> build_index(std::vector<std::unique_ptr<geos::geom::Point>> &geometry, std::function<void(size_t, size_t)> progress)
     {
         auto index = std::make_unique<geos::index::strtree::STRtree>();
 
         for (int i = 0; i < geometry.size(); i++)
         {
-            index->insert(geometry[i]->getEnvelopeInternal(), geometry[i].get());
+            if (geometry[i])
+            {
+                index->insert(geometry[i]->getEnvelopeInternal(), geometry[i].get());
+            }
+
             progress(i, geometry.size());
         }
 
         index->build();
+
+        _pending_updates = 0;
+        _retired.clear();
+
         return index;
     }
+
+    bool supports_updates()
+    {
+        return true;
+    }
+
+    void apply_update(std::unique_ptr<geos::index::strtree::STRtree> &index, std::vector<std::unique_ptr<geos::geom::Point>> &geometry, const PointUpdate &update)
+    {
+        auto point = update.kind == PointUpdate::REMOVE ? nullptr : this->displaced_point(geometry, update);
+
+        if (geometry[update.id])
+        {
+            _retired.push_back(std::move(geometry[update.id]));
+        }
+
+        geometry[update.id] = std::move(point);
+
+        if (++_pending_updates >= std::max(1.0, _rebuild_fraction * geometry.size()))
+        {
+            index = build_index(geometry, [](size_t i, size_t n) {});
+        }
+    }
+
+    // STRtree only finds the single nearest neighbour natively, larger k use the window search.
+    void execute_knn_queries(geos::index::strtree::STRtree *index, QuerySlice<GeosKnnQuery> queries, size_t k, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        if (k != 1)
+        {
+            GeosIndexExperimentRunner<geos::index::strtree::STRtree>::execute_knn_queries(index, queries, k, latencies, progress);
+            return;
+        }
+
+        geos::index::strtree::GeometryItemDistance item_distance;
+        std::vector<const geos::geom::Point *> result;
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            auto target_point = queries[i].point.get();
+
+            result.clear();
+            result.push_back(static_cast<const geos::geom::Point *>(index->nearestNeighbour(target_point->getEnvelopeInternal(), target_point, &item_distance)));
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
 };
\ No newline at end of file
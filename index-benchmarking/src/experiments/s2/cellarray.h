@@ -0,0 +1,128 @@
+#pragma once
+#include <vector>
+#include "s2/s2cap.h"
+#include "s2/s2earth.h"
+#include "s2/s2region_coverer.h"
+#include "../../indexes/s2_cell_array.h"
+#include "common.h"
+
+// Executors shared by indexes that answer a query through an S2 cell covering, i.e. that provide
+// query(region, coverer, covering, visit(id)) and bytes(), plus the snapshot interface of utils/snapshot.h.
+template <typename TIndex>
+class S2CoveringExperimentRunner : public S2ExperimentRunner<TIndex>
+{
+private:
+    int _max_cells;
+
+public:
+    // max_cells bounds the number of covering cells, i.e. the number of searches per query.
+    S2CoveringExperimentRunner(std::string name, int max_cells) : S2ExperimentRunner<TIndex>(name), _max_cells(max_cells){};
+
+private:
+    size_t index_structural_bytes(TIndex *index)
+    {
+        return index->bytes();
+    }
+
+    size_t save_index(TIndex *index, std::string file_path)
+    {
+        return save_snapshot(*index, file_path);
+    }
+
+    std::unique_ptr<TIndex> load_index(std::string file_path)
+    {
+        return load_snapshot<TIndex>(file_path);
+    }
+
+    void execute_distance_queries(TIndex *index, QuerySlice<S2DistanceQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        S2RegionCoverer::Options options;
+        options.set_max_cells(_max_cells);
+        S2RegionCoverer coverer(options);
+
+        std::vector<S2CellId> covering;
+        std::vector<uint32_t> result;
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            S2Cap cap(queries[i].point, S2Earth::ToAngle(util::units::Meters(queries[i].distance)));
+
+            result.clear();
+            index->query(cap, coverer, covering, [&result](uint32_t id) { result.push_back(id); });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+    void execute_range_queries(TIndex *index, QuerySlice<S2RangeQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        S2RegionCoverer::Options options;
+        options.set_max_cells(_max_cells);
+        S2RegionCoverer coverer(options);
+
+        std::vector<S2CellId> covering;
+        std::vector<uint32_t> result;
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            result.clear();
+            index->query(queries[i].range, coverer, covering, [&result](uint32_t id) { result.push_back(id); });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+    void execute_knn_queries(TIndex *index, QuerySlice<S2KnnQuery> queries, size_t k, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        S2RegionCoverer::Options options;
+        options.set_max_cells(_max_cells);
+        S2RegionCoverer coverer(options);
+
+        std::vector<S2CellId> covering;
+        std::vector<uint32_t> result;
+        KnnHeap<uint32_t> heap(k);
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            result.clear();
+            heap.clear();
+            index->query_knn(queries[i].point, coverer, covering, heap);
+
+            for (const auto &neighbour : heap.sorted())
+            {
+                result.push_back(neighbour.second);
+            }
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+};
+
+class S2CellArrayExperimentRunner : public S2CoveringExperimentRunner<S2CellArray>
+{
+public:
+    S2CellArrayExperimentRunner(std::string name, int max_cells = 8) : S2CoveringExperimentRunner<S2CellArray>(name, max_cells){};
+
+private:
+    std::unique_ptr<S2CellArray> build_index(std::vector<S2Point> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        auto index = std::make_unique<S2CellArray>(geometry);
+        progress(geometry.size(), geometry.size());
+        return index;
+    }
+};
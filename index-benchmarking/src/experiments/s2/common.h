@@ -1,10 +1,129 @@
 #pragma once
 #include <memory>
+#include <cmath>
 #include "s2/s2polygon.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2point.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2earth.h"
 #include "../experiment.h"
+#include "../../utils/parallel.h"
 
 typedef DistanceQuery<S2Point> S2DistanceQuery;
 typedef RangeQuery<S2LatLngRect> S2RangeQuery;
+typedef KnnQuery<S2Point> S2KnnQuery;
 typedef RangeQuery<std::unique_ptr<S2Polygon>> S2ShapeRangeQuery;
+
+// Loads geometry and queries as S2 objects. Executors are left to the subclass.
+template <typename TIndex>
+class S2ExperimentRunner : public BaseExperimentRunner<TIndex, S2Point, S2DistanceQuery, S2RangeQuery, S2KnnQuery>
+{
+public:
+    S2ExperimentRunner(std::string name) : BaseExperimentRunner<TIndex, S2Point, S2DistanceQuery, S2RangeQuery, S2KnnQuery>(name){};
+
+protected:
+    // New point for an insert or move: the anchor point offset by the update, dx meters east and dy meters north.
+    static S2Point displaced_point(const std::vector<S2Point> &geometry, const PointUpdate &update)
+    {
+        S2LatLng anchor(geometry[update.anchor]);
+        double lat = anchor.lat().radians();
+        double lng = anchor.lng().radians();
+
+        lat += update.dy / S2Earth::RadiusMeters();
+        lng += update.dx / (S2Earth::RadiusMeters() * std::max(1e-6, std::cos(lat)));
+
+        return S2LatLng::FromRadians(lat, lng).Normalized().ToPoint();
+    }
+
+private:
+    std::vector<S2Point> load_geometry(std::string file_path, std::function<void(size_t, size_t)> progress)
+    {
+        CoordinateFile coordinates(file_path);
+        auto span = coordinates.span();
+
+        std::vector<S2Point> s2_points(span.size());
+        std::atomic<size_t> done(0);
+
+        // S2LatLng -> S2Point is a pure function, so every thread converts a block straight into the output.
+        parallel_for(span.size(), hardware_threads(), [&](size_t begin, size_t end, unsigned int thread_id) {
+            for (auto chunk : span.subspan(begin, end - begin).chunks(1 << 14))
+            {
+                for (size_t i = 0; i < chunk.size(); i++)
+                {
+                    auto coordinate = chunk[i];
+                    s2_points[chunk.offset() + i] = S2LatLng::FromDegrees(coordinate.lat, coordinate.lon).ToPoint();
+                }
+
+                progress(done += chunk.size(), span.size());
+            }
+        }, 1 << 14);
+
+        return s2_points;
+    }
+
+    std::vector<S2DistanceQuery> load_distance_queries(std::string file_path, std::function<void(size_t, size_t)> progress)
+    {
+        auto raw_queries = _load_distance_queries(file_path);
+
+        std::vector<S2DistanceQuery> queries;
+
+        for (size_t i = 0; i < raw_queries.size(); i++)
+        {
+            auto q = raw_queries[i];
+            queries.push_back({S2LatLng::FromDegrees(q.coord.lat, q.coord.lon).ToPoint(), q.distance});
+            progress(i, raw_queries.size());
+        }
+
+        return queries;
+    }
+
+    std::vector<S2RangeQuery> load_range_queries(std::string file_path, std::function<void(size_t, size_t)> progress)
+    {
+        auto raw_queries = _load_range_queries(file_path);
+
+        std::vector<S2RangeQuery> queries;
+
+        for (size_t i = 0; i < raw_queries.size(); i++)
+        {
+            auto q = raw_queries[i];
+            queries.push_back({S2LatLngRect(
+                S2LatLng::FromDegrees(q.a.lat, q.a.lon),
+                S2LatLng::FromDegrees(q.b.lat, q.b.lon))});
+            progress(i, raw_queries.size());
+        }
+
+        return queries;
+    }
+
+    std::vector<S2KnnQuery> load_knn_queries(std::string file_path, std::function<void(size_t, size_t)> progress)
+    {
+        auto raw_queries = _load_knn_queries(file_path);
+
+        std::vector<S2KnnQuery> queries;
+
+        for (size_t i = 0; i < raw_queries.size(); i++)
+        {
+            auto q = raw_queries[i];
+            queries.push_back({S2LatLng::FromDegrees(q.coord.lat, q.coord.lon).ToPoint()});
+            progress(i, raw_queries.size());
+        }
+
+        return queries;
+    }
+
+    // Batches are sorted along the S2 curve.
+    uint64_t locality_key(const S2DistanceQuery &query)
+    {
+        return S2CellId(query.point).id();
+    }
+
+    uint64_t locality_key(const S2RangeQuery &query)
+    {
+        return S2CellId(query.range.GetCenter().ToPoint()).id();
+    }
+
+    uint64_t locality_key(const S2KnnQuery &query)
+    {
+        return S2CellId(query.point).id();
+    }
+};
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include "../../indexes/learned_cell_index.h"
+#include "cellarray.h"
+
+class LearnedIndexExperimentRunner : public S2CoveringExperimentRunner<LearnedCellIndex>
+{
+private:
+    size_t _keys_per_model;
+
+public:
+    // keys_per_model sets the number of leaf models to n / keys_per_model.
+    LearnedIndexExperimentRunner(std::string name, int max_cells = 8, size_t keys_per_model = 1024) : S2CoveringExperimentRunner<LearnedCellIndex>(name, max_cells), _keys_per_model(keys_per_model){};
+
+private:
+    std::unique_ptr<LearnedCellIndex> build_index(std::vector<S2Point> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        auto index = std::make_unique<LearnedCellIndex>(geometry, _keys_per_model);
+        progress(geometry.size(), geometry.size());
+        return index;
+    }
+
+    std::vector<std::pair<std::string, std::string>> index_properties(LearnedCellIndex *index)
+    {
+        const auto &model = index->model();
+
+        return {
+            {"n_models", std::to_string(model.n_models())},
+            {"model_size", std::to_string(model.bytes() / 1e6) + " MB"},
+            {"max_error", std::to_string(model.max_error())},
+            {"mean_error", std::to_string(model.mean_error())},
+        };
+    }
+};
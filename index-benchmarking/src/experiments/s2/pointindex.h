@@ -7,125 +7,103 @@
 #include "common.h"
 #include "../experiment.h"
 
-class S2PointIndexExperimentRunner : public BaseExperimentRunner<S2PointIndex<int>, S2Point, DistanceQuery<S2Point>, S2RangeQuery>
+class S2PointIndexExperimentRunner : public S2ExperimentRunner<S2PointIndex<int>>
 {
 public:
-    S2PointIndexExperimentRunner(std::string name, std::string executable_name) : BaseExperimentRunner(name, executable_name){};
+    S2PointIndexExperimentRunner(std::string name) : S2ExperimentRunner<S2PointIndex<int>>(name){};
 
 private:
-    std::vector<S2Point> load_geometry(std::string file_path, std::function<void(size_t, size_t)> progress)
+    std::unique_ptr<S2PointIndex<int>> build_index(std::vector<S2Point> &geometry, std::function<void(size_t, size_t)> progress)
     {
-        auto coordinates = load_coordinates(file_path);
-        std::vector<S2Point> s2_points;
+        auto index = std::make_unique<S2PointIndex<int>>();
 
-        for (size_t i = 0; i < coordinates.size(); i++)
+        for (size_t i = 0; i < geometry.size(); i++)
         {
-            auto coordinate = coordinates[i];
-            s2_points.push_back(S2LatLng::FromDegrees(coordinate.lat, coordinate.lon).ToPoint());
-            progress(i, coordinates.size());
+            index->Add(geometry[i], i);
+            progress(i, geometry.size());
         }
 
-        return s2_points;
+        return index;
     }
 
-    std::vector<S2DistanceQuery> load_distance_queries(std::string file_path, std::function<void(size_t, size_t)> progress)
+    bool supports_updates()
     {
-        auto raw_queries = _load_distance_queries(file_path);
-
-        std::vector<S2DistanceQuery> queries;
-
-        for (size_t i = 0; i < raw_queries.size(); i++)
-        {
-            auto q = raw_queries[i];
-            queries.push_back({S2LatLng::FromDegrees(q.coord.lat, q.coord.lon).ToPoint(), q.distance});
-            progress(i, raw_queries.size());
-        }
-
-        return queries;
+        return true;
     }
 
-    std::vector<S2RangeQuery> load_range_queries(std::string file_path, std::function<void(size_t, size_t)> progress)
+    // S2PointIndex is updated in place, a point is removed by its position and id.
+    void apply_update(std::unique_ptr<S2PointIndex<int>> &index, std::vector<S2Point> &geometry, const PointUpdate &update)
     {
-        auto raw_queries = _load_range_queries(file_path);
-
-        std::vector<S2RangeQuery> queries;
-
-        for (size_t i = 0; i < raw_queries.size(); i++)
+        if (update.kind != PointUpdate::INSERT)
         {
-            auto q = raw_queries[i];
-            queries.push_back({S2LatLngRect(
-                S2LatLng::FromDegrees(q.a.lat, q.a.lon),
-                S2LatLng::FromDegrees(q.b.lat, q.b.lon))});
-            progress(i, raw_queries.size());
+            index->Remove(geometry[update.id], update.id);
         }
 
-        return queries;
-    }
-
-    std::unique_ptr<S2PointIndex<int>> build_index(std::vector<S2Point> &geometry, std::function<void(size_t, size_t)> progress)
-    {
-        auto index = std::make_unique<S2PointIndex<int>>();
-
-        for (size_t i = 0; i < geometry.size(); i++)
+        if (update.kind == PointUpdate::REMOVE)
         {
-            index->Add(geometry[i], i);
-            progress(i, geometry.size());
+            return;
         }
 
-        return index;
+        geometry[update.id] = displaced_point(geometry, update);
+        index->Add(geometry[update.id], update.id);
     }
 
-    void execute_distance_queries(S2PointIndex<int> *index, std::vector<S2DistanceQuery> &queries, std::function<void(size_t, size_t)> progress)
+    void execute_distance_queries(S2PointIndex<int> *index, QuerySlice<S2DistanceQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
     {
         S2ClosestPointQuery<int> query(index);
 
-        // Run for at most 2 minutes to prevent excessive compute usage. This should be enough to get an approximate throughput.
-        int max_seconds = 2 * 60;
-        auto start_time = std::chrono::high_resolution_clock::now();
-
         for (size_t i = 0; i < queries.size(); i++)
         {
+            auto query_start = std::chrono::steady_clock::now();
+
             S2ClosestPointQueryPointTarget target(queries[i].point);
 
             query.mutable_options()->set_max_distance(S2Earth::ToAngle(util::units::Meters(queries[i].distance)));
             query.FindClosestPoints(&target);
 
-            auto current_time = std::chrono::high_resolution_clock::now();
-            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
 
             progress(i, queries.size());
-
-            if (seconds >= max_seconds)
-            {
-                break;
-            }
         }
     }
 
-    void execute_range_queries(S2PointIndex<int> *index, std::vector<S2RangeQuery> &queries, std::function<void(size_t, size_t)> progress)
+    void execute_range_queries(S2PointIndex<int> *index, QuerySlice<S2RangeQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
     {
         S2ClosestPointQuery<int> query(index);
 
-        // Run for at most 2 minutes to prevent excessive compute usage. This should be enough to get an approximate throughput.
-        int max_seconds = 2 * 60;
-        auto start_time = std::chrono::high_resolution_clock::now();
-
         for (size_t i = 0; i < queries.size(); i++)
         {
+            auto query_start = std::chrono::steady_clock::now();
+
             S2ClosestPointQueryPointTarget target(queries[i].range.GetCenter().ToPoint());
 
             query.mutable_options()->set_region(&queries[i].range);
             auto result = query.FindClosestPoints(&target);
 
-            auto current_time = std::chrono::high_resolution_clock::now();
-            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
 
             progress(i, queries.size());
+        }
+    }
+
+    void execute_knn_queries(S2PointIndex<int> *index, QuerySlice<S2KnnQuery> queries, size_t k, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        S2ClosestPointQuery<int> query(index);
+        query.mutable_options()->set_max_results(k);
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
 
-            if (seconds >= max_seconds)
-            {
-                break;
-            }
+            S2ClosestPointQueryPointTarget target(queries[i].point);
+            auto result = query.FindClosestPoints(&target);
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
         }
     }
 };
\ No newline at end of file
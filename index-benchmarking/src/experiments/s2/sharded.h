@@ -0,0 +1,270 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include "s2/s2cap.h"
+#include "s2/s2earth.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s2point_index.h"
+#include "s2/s2closest_point_query.h"
+#include "../../indexes/sharded_index.h"
+#include "../../utils/threadpool.h"
+#include "../../utils/knn.h"
+#include "common.h"
+
+// Smallest and largest leaf cell id of the points in a shard.
+struct S2CellIdRange
+{
+    uint64_t lo;
+    uint64_t hi;
+};
+
+typedef ShardedIndex<S2PointIndex<int>, S2CellIdRange> ShardedS2PointIndex;
+
+// Splits the points into n_shards runs of equal size along the S2 curve and builds one S2PointIndex per shard in
+// parallel. A query is routed to the shards whose cell id range overlaps a covering of its region, which are then
+// searched on a thread pool of the index, created with it so that its threads are counted by the hardware counters of
+// the run.
+class ShardedS2PointIndexExperimentRunner : public S2ExperimentRunner<ShardedS2PointIndex>
+{
+private:
+    unsigned int _n_shards;
+    int _max_cells;
+
+public:
+    ShardedS2PointIndexExperimentRunner(std::string name, unsigned int n_shards = hardware_threads(), int max_cells = 8) : S2ExperimentRunner<ShardedS2PointIndex>(name), _n_shards(n_shards), _max_cells(max_cells){};
+
+private:
+    static bool overlaps(const std::vector<S2CellId> &covering, const S2CellIdRange &bounds)
+    {
+        for (const auto &cell : covering)
+        {
+            if (cell.range_min().id() <= bounds.hi && cell.range_max().id() >= bounds.lo)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // One query object per shard. Each is only used by the task of its own shard, so they need no locking.
+    static std::vector<std::unique_ptr<S2ClosestPointQuery<int>>> shard_queries(ShardedS2PointIndex *index)
+    {
+        std::vector<std::unique_ptr<S2ClosestPointQuery<int>>> queries;
+
+        for (size_t s = 0; s < index->n_shards(); s++)
+        {
+            queries.push_back(std::make_unique<S2ClosestPointQuery<int>>(&index->shard(s)));
+        }
+
+        return queries;
+    }
+
+    std::unique_ptr<ShardedS2PointIndex> build_index(std::vector<S2Point> &geometry, std::function<void(size_t, size_t)> progress)
+    {
+        std::vector<uint64_t> keys(geometry.size());
+
+        parallel_for(geometry.size(), hardware_threads(), [&](size_t begin, size_t end, unsigned int thread_id) {
+            for (size_t i = begin; i < end; i++)
+            {
+                keys[i] = S2CellId(geometry[i]).id();
+            }
+        }, 1 << 14);
+
+        auto layout = key_shard_layout(keys.data(), geometry.size(), _n_shards);
+        std::atomic<size_t> done(0);
+
+        return std::make_unique<ShardedS2PointIndex>(layout, std::make_shared<ThreadPool>(), [&](const uint32_t *ids, size_t n, S2CellIdRange &bounds) {
+            auto index = std::make_unique<S2PointIndex<int>>();
+
+            // Shard ids are sorted by cell id.
+            bounds = {n > 0 ? keys[ids[0]] : 0, n > 0 ? keys[ids[n - 1]] : 0};
+
+            for (size_t j = 0; j < n; j++)
+            {
+                index->Add(geometry[ids[j]], ids[j]);
+
+                if (j % (1 << 14) == 0)
+                {
+                    progress(done += std::min<size_t>(1 << 14, n - j), geometry.size());
+                }
+            }
+
+            return index;
+        });
+    }
+
+    std::vector<std::pair<std::string, std::string>> index_properties(ShardedS2PointIndex *index)
+    {
+        return {
+            {"n_shards", std::to_string(index->n_shards())},
+            {"max_shard_size", std::to_string(index->max_shard_size())},
+        };
+    }
+
+    void execute_distance_queries(ShardedS2PointIndex *index, QuerySlice<S2DistanceQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        S2RegionCoverer::Options options;
+        options.set_max_cells(_max_cells);
+        S2RegionCoverer coverer(options);
+
+        std::vector<S2CellId> covering;
+        auto closest_point_queries = shard_queries(index);
+        std::vector<std::vector<S2ClosestPointQuery<int>::Result>> found(index->n_shards());
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            const auto &point = queries[i].point;
+            auto radius = S2Earth::ToAngle(util::units::Meters(queries[i].distance));
+
+            S2Cap cap(point, radius);
+            coverer.GetCovering(cap, &covering);
+
+            index->fan_out([&covering](const S2CellIdRange &bounds) { return overlaps(covering, bounds); },
+                           [&](S2PointIndex<int> &shard, size_t s) {
+                               S2ClosestPointQueryPointTarget target(point);
+
+                               closest_point_queries[s]->mutable_options()->set_max_distance(radius);
+                               found[s].clear();
+                               closest_point_queries[s]->FindClosestPoints(&target, &found[s]);
+                           });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+    void execute_range_queries(ShardedS2PointIndex *index, QuerySlice<S2RangeQuery> queries, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        S2RegionCoverer::Options options;
+        options.set_max_cells(_max_cells);
+        S2RegionCoverer coverer(options);
+
+        std::vector<S2CellId> covering;
+        auto closest_point_queries = shard_queries(index);
+        std::vector<std::vector<S2ClosestPointQuery<int>::Result>> found(index->n_shards());
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            const auto &range = queries[i].range;
+            coverer.GetCovering(range, &covering);
+
+            index->fan_out([&covering](const S2CellIdRange &bounds) { return overlaps(covering, bounds); },
+                           [&](S2PointIndex<int> &shard, size_t s) {
+                               S2ClosestPointQueryPointTarget target(range.GetCenter().ToPoint());
+
+                               closest_point_queries[s]->mutable_options()->set_region(&range);
+                               found[s].clear();
+                               closest_point_queries[s]->FindClosestPoints(&target, &found[s]);
+                           });
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+
+    // The shard holding the query point is searched first. The distance to its k-th neighbour bounds the search,
+    // so only shards overlapping a cap of that radius are visited next.
+    void execute_knn_queries(ShardedS2PointIndex *index, QuerySlice<S2KnnQuery> queries, size_t k, LatencyHistogram &latencies, ProgressCounter &progress)
+    {
+        S2RegionCoverer::Options options;
+        options.set_max_cells(_max_cells);
+        S2RegionCoverer coverer(options);
+
+        std::vector<S2CellId> covering;
+        auto closest_point_queries = shard_queries(index);
+        std::vector<std::vector<S2ClosestPointQuery<int>::Result>> found(index->n_shards());
+        KnnHeap<int> heap(k);
+
+        for (auto &query : closest_point_queries)
+        {
+            query->mutable_options()->set_max_results(k);
+        }
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto query_start = std::chrono::steady_clock::now();
+
+            const auto &point = queries[i].point;
+            uint64_t key = S2CellId(point).id();
+
+            // Shards are ordered by cell id, the first non-empty shard ending at or after the key is closest along the curve.
+            size_t home = 0;
+
+            for (size_t s = 0; s < index->n_shards(); s++)
+            {
+                if (index->shard_size(s) > 0)
+                {
+                    home = s;
+
+                    if (index->bounds(s).hi >= key)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            S2ClosestPointQueryPointTarget target(point);
+            closest_point_queries[home]->mutable_options()->set_max_distance(S1ChordAngle::Infinity());
+            found[home].clear();
+            closest_point_queries[home]->FindClosestPoints(&target, &found[home]);
+
+            heap.clear();
+
+            for (const auto &result : found[home])
+            {
+                heap.push(result.distance().length2(), result.data());
+            }
+
+            bool bounded = heap.full();
+            auto radius = bounded ? S1ChordAngle::FromLength2(heap.bound()) : S1ChordAngle::Infinity();
+
+            if (bounded)
+            {
+                coverer.GetCovering(S2Cap(point, radius), &covering);
+            }
+
+            for (auto &shard_found : found)
+            {
+                shard_found.clear();
+            }
+
+            index->fan_out([&](const S2CellIdRange &bounds) { return !bounded || overlaps(covering, bounds); },
+                           [&](S2PointIndex<int> &shard, size_t s) {
+                               if (s == home)
+                               {
+                                   return;
+                               }
+
+                               S2ClosestPointQueryPointTarget shard_target(point);
+
+                               closest_point_queries[s]->mutable_options()->set_max_distance(radius);
+                               closest_point_queries[s]->FindClosestPoints(&shard_target, &found[s]);
+                           });
+
+            for (size_t s = 0; s < found.size(); s++)
+            {
+                for (const auto &result : found[s])
+                {
+                    heap.push(result.distance().length2(), result.data());
+                }
+            }
+
+            auto result = heap.sorted();
+
+            auto current_time = std::chrono::steady_clock::now();
+            latencies.record(current_time - query_start);
+
+            progress(i, queries.size());
+        }
+    }
+};
@@ -0,0 +1,487 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "../utils/refine.h"
+#include "../utils/knn.h"
+#include "../utils/flat_array.h"
+#include "../utils/snapshot.h"
+
+// Uniform grid over the bounding box of a point set. Points are stored contiguously per cell (CSR layout): the
+// points of cell c are [_offsets[c], _offsets[c + 1]) of the structure-of-arrays x, y and id arrays, and cells are
+// numbered row-major, so a row of cells is one contiguous run as well. Cells that hold many more points than the
+// average occupied cell can be split into a k x k subgrid, stored the same way within the range of the cell.
+class GridIndex
+{
+public:
+    // Runs are refined in chunks of this size, so the refinement mask fits on the stack.
+    enum
+    {
+        REFINE_CHUNK = 256,
+        MAX_SUBGRID_SIZE = 64,
+        SNAPSHOT_VERSION = 1,
+    };
+
+private:
+    struct Subgrid
+    {
+        uint32_t k;      // subcells per side
+        uint32_t offset; // first entry in _sub_offsets, which holds k * k + 1 positions
+    };
+
+    double _min_x;
+    double _min_y;
+    double _cell_size;
+    size_t _nx;
+    size_t _ny;
+
+    FlatArray<uint32_t> _offsets;
+
+    // Points in cell order.
+    FlatArray<double> _x;
+    FlatArray<double> _y;
+    FlatArray<uint32_t> _ids;
+
+    // Subgrid per cell (-1 if not split), empty if heavy cells are not split.
+    FlatArray<int32_t> _subgrid;
+    FlatArray<Subgrid> _subgrids;
+    FlatArray<uint32_t> _sub_offsets;
+
+    // Cell coordinate along one axis. Monotone in value, so points in cells strictly between the cells of the
+    // query bounds are strictly inside the bounds.
+    static inline size_t cell_of(double value, double origin, double size, size_t n)
+    {
+        double cell = std::floor((value - origin) / size);
+        return (size_t)std::min(std::max(cell, 0.0), (double)(n - 1));
+    }
+
+    // Counting sort of positions [begin, end) by key, where keys[i - begin] < n_keys. Writes n_keys + 1 offsets
+    // (relative to begin) and reorders the point arrays.
+    void sort_by_key(size_t begin, size_t end, const std::vector<uint32_t> &keys, size_t n_keys, uint32_t *offsets)
+    {
+        std::fill(offsets, offsets + n_keys + 1, 0);
+
+        for (auto key : keys)
+        {
+            offsets[key + 1]++;
+        }
+
+        for (size_t i = 0; i < n_keys; i++)
+        {
+            offsets[i + 1] += offsets[i];
+        }
+
+        std::vector<uint32_t> next(offsets, offsets + n_keys);
+        std::vector<double> x(end - begin), y(end - begin);
+        std::vector<uint32_t> ids(end - begin);
+
+        for (size_t i = begin; i < end; i++)
+        {
+            auto position = next[keys[i - begin]]++;
+            x[position] = _x[i];
+            y[position] = _y[i];
+            ids[position] = _ids[i];
+        }
+
+        std::copy(x.begin(), x.end(), _x.begin() + begin);
+        std::copy(y.begin(), y.end(), _y.begin() + begin);
+        std::copy(ids.begin(), ids.end(), _ids.begin() + begin);
+    }
+
+    void split(size_t cell, size_t k)
+    {
+        size_t begin = _offsets[cell];
+        size_t end = _offsets[cell + 1];
+
+        double origin_x = _min_x + (cell % _nx) * _cell_size;
+        double origin_y = _min_y + (cell / _nx) * _cell_size;
+        double size = _cell_size / k;
+
+        std::vector<uint32_t> keys(end - begin);
+
+        for (size_t i = begin; i < end; i++)
+        {
+            keys[i - begin] = cell_of(_y[i], origin_y, size, k) * k + cell_of(_x[i], origin_x, size, k);
+        }
+
+        _subgrid[cell] = _subgrids.size();
+        _subgrids.push_back({(uint32_t)k, (uint32_t)_sub_offsets.size()});
+        _sub_offsets.resize(_sub_offsets.size() + k * k + 1);
+
+        auto offsets = &_sub_offsets[_subgrids.back().offset];
+        sort_by_key(begin, end, keys, k * k, offsets);
+
+        for (size_t i = 0; i <= k * k; i++)
+        {
+            offsets[i] += begin;
+        }
+    }
+
+    // Call run(begin, end, contained) for position ranges that together hold every point in the subgrid of the
+    // cell that may lie inside the box.
+    template <typename TRun>
+    void scan_subgrid(size_t cell, double min_x, double min_y, double max_x, double max_y, TRun run) const
+    {
+        const auto &subgrid = _subgrids[_subgrid[cell]];
+        const auto offsets = &_sub_offsets[subgrid.offset];
+
+        double origin_x = _min_x + (cell % _nx) * _cell_size;
+        double origin_y = _min_y + (cell / _nx) * _cell_size;
+        double size = _cell_size / subgrid.k;
+
+        size_t sx0 = cell_of(min_x, origin_x, size, subgrid.k);
+        size_t sx1 = cell_of(max_x, origin_x, size, subgrid.k);
+        size_t sy0 = cell_of(min_y, origin_y, size, subgrid.k);
+        size_t sy1 = cell_of(max_y, origin_y, size, subgrid.k);
+
+        for (size_t sy = sy0; sy <= sy1; sy++)
+        {
+            size_t begin = offsets[sy * subgrid.k + sx0];
+            size_t end = offsets[sy * subgrid.k + sx1 + 1];
+
+            if (end > begin)
+            {
+                run(begin, end, false);
+            }
+        }
+    }
+
+    // Call run(begin, end, contained) for position ranges that together hold every point that may lie inside the
+    // box. Ranges with contained set only hold points inside the box.
+    template <typename TRun>
+    void scan(double min_x, double min_y, double max_x, double max_y, TRun run) const
+    {
+        if (_x.empty() || max_x < min_x || max_y < min_y)
+        {
+            return;
+        }
+
+        size_t cx0 = cell_of(min_x, _min_x, _cell_size, _nx);
+        size_t cx1 = cell_of(max_x, _min_x, _cell_size, _nx);
+        size_t cy0 = cell_of(min_y, _min_y, _cell_size, _ny);
+        size_t cy1 = cell_of(max_y, _min_y, _cell_size, _ny);
+
+        for (size_t cy = cy0; cy <= cy1; cy++)
+        {
+            size_t row = cy * _nx;
+            bool inner_row = cy0 < cy && cy < cy1;
+
+            // Consecutive cells of a row are merged into a single run as long as they agree on containment.
+            size_t pending = _offsets[row + cx0];
+            bool pending_contained = false;
+
+            auto flush = [&](size_t end) {
+                if (end > pending)
+                {
+                    run(pending, end, pending_contained);
+                }
+
+                pending = end;
+            };
+
+            for (size_t cx = cx0; cx <= cx1; cx++)
+            {
+                size_t cell = row + cx;
+                bool contained = inner_row && cx0 < cx && cx < cx1;
+
+                if (contained != pending_contained)
+                {
+                    flush(_offsets[cell]);
+                    pending_contained = contained;
+                }
+
+                if (!contained && !_subgrid.empty() && _subgrid[cell] >= 0)
+                {
+                    flush(_offsets[cell]);
+                    scan_subgrid(cell, min_x, min_y, max_x, max_y, run);
+                    pending = _offsets[cell + 1];
+                }
+            }
+
+            flush(_offsets[row + cx1 + 1]);
+        }
+    }
+
+public:
+    // Cells with more than four times the average number of points per occupied cell are split into a subgrid
+    // with about that average per subcell if split_heavy_cells is set.
+    GridIndex(const double *x, const double *y, size_t n, double cell_size, bool split_heavy_cells = true) : _min_x(0), _min_y(0), _cell_size(cell_size), _nx(1), _ny(1), _x(x, x + n), _y(y, y + n), _ids(n)
+    {
+        double max_x = 0, max_y = 0;
+
+        if (n > 0)
+        {
+            auto mm_x = std::minmax_element(x, x + n);
+            auto mm_y = std::minmax_element(y, y + n);
+
+            _min_x = *mm_x.first;
+            _min_y = *mm_y.first;
+            max_x = *mm_x.second;
+            max_y = *mm_y.second;
+        }
+
+        if (!(_cell_size > 0))
+        {
+            _cell_size = std::max({max_x - _min_x, max_y - _min_y, 1.0});
+        }
+
+        _nx = std::max<size_t>(1, std::ceil((max_x - _min_x) / _cell_size));
+        _ny = std::max<size_t>(1, std::ceil((max_y - _min_y) / _cell_size));
+
+        std::vector<uint32_t> keys(n);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            _ids[i] = i;
+            keys[i] = cell_of(y[i], _min_y, _cell_size, _ny) * _nx + cell_of(x[i], _min_x, _cell_size, _nx);
+        }
+
+        _offsets.resize(_nx * _ny + 1);
+        sort_by_key(0, n, keys, _nx * _ny, _offsets.data());
+
+        if (!split_heavy_cells || n == 0)
+        {
+            return;
+        }
+
+        size_t occupied = 0;
+
+        for (size_t cell = 0; cell < _nx * _ny; cell++)
+        {
+            occupied += _offsets[cell + 1] > _offsets[cell];
+        }
+
+        double target = (double)n / occupied;
+        _subgrid.assign(_nx * _ny, -1);
+
+        for (size_t cell = 0; cell < _nx * _ny; cell++)
+        {
+            size_t count = _offsets[cell + 1] - _offsets[cell];
+
+            if (count > 4 * target)
+            {
+                split(cell, std::min<size_t>(MAX_SUBGRID_SIZE, std::ceil(std::sqrt(count / target))));
+            }
+        }
+    }
+
+    // Maps the arrays of a snapshot written by save().
+    GridIndex(SnapshotReader &reader) : _min_x(reader.value<double>()), _min_y(reader.value<double>()), _cell_size(reader.value<double>()), _nx(reader.value<size_t>()), _ny(reader.value<size_t>()),
+                                        _offsets(reader.array<uint32_t>()), _x(reader.array<double>()), _y(reader.array<double>()), _ids(reader.array<uint32_t>()),
+                                        _subgrid(reader.array<int32_t>()), _subgrids(reader.array<Subgrid>()), _sub_offsets(reader.array<uint32_t>()){};
+
+    static const char *snapshot_kind()
+    {
+        return "grid_index";
+    }
+
+    void save(SnapshotWriter &writer) const
+    {
+        writer.value(_min_x);
+        writer.value(_min_y);
+        writer.value(_cell_size);
+        writer.value(_nx);
+        writer.value(_ny);
+        writer.array(_offsets);
+        writer.array(_x);
+        writer.array(_y);
+        writer.array(_ids);
+        writer.array(_subgrid);
+        writer.array(_subgrids);
+        writer.array(_sub_offsets);
+    }
+
+    // Cell size that minimizes the expected cost of the given query selectivities (fractions of n), relative to
+    // the number of results. A query of selectivity s covers about s * area, so it touches (q / h + 1)^2 cells of
+    // size h and refines the points in (q + h)^2, where q = sqrt(s * area). Assumes a uniform density; heavy cells
+    // are taken care of by the subgrids. Without any known selectivity, cells hold a few points on average.
+    static double tune_cell_size(const double *x, const double *y, size_t n, const std::vector<double> &selectivities)
+    {
+        // Visiting a cell costs about as much as refining this many points.
+        const double cell_cost = 4;
+        const double default_points_per_cell = 4;
+
+        if (n == 0)
+        {
+            return 1;
+        }
+
+        auto mm_x = std::minmax_element(x, x + n);
+        auto mm_y = std::minmax_element(y, y + n);
+
+        double width = *mm_x.second - *mm_x.first;
+        double height = *mm_y.second - *mm_y.first;
+        double extent = std::max({width, height, 1e-9});
+        double area = std::max(width * height, extent * extent / n);
+
+        // At least one point per cell on average, which bounds the size of the cell array by n.
+        double min_size = std::sqrt(area / n);
+        double best_size = std::sqrt(default_points_per_cell * area / n);
+        double best_cost = std::numeric_limits<double>::infinity();
+
+        for (double size = min_size; size <= 2 * extent; size *= std::pow(2, 0.125))
+        {
+            double cost = 0;
+            bool known = false;
+
+            for (auto selectivity : selectivities)
+            {
+                if (!(selectivity > 0))
+                {
+                    continue;
+                }
+
+                double results = std::max(1.0, selectivity * n);
+                double q = std::sqrt(selectivity * area);
+
+                cost += (cell_cost * std::pow(q / size + 1, 2) + n / area * std::pow(q + size, 2)) / results;
+                known = true;
+            }
+
+            if (known && cost < best_cost)
+            {
+                best_cost = cost;
+                best_size = size;
+            }
+        }
+
+        return std::max(best_size, min_size);
+    }
+
+    inline size_t size() const
+    {
+        return _x.size();
+    }
+
+    inline double cell_size() const
+    {
+        return _cell_size;
+    }
+
+    inline size_t n_cells() const
+    {
+        return _nx * _ny;
+    }
+
+    inline size_t n_split_cells() const
+    {
+        return _subgrids.size();
+    }
+
+    size_t bytes() const
+    {
+        return sizeof(*this) + _offsets.capacity() * sizeof(uint32_t) + (_x.capacity() + _y.capacity()) * sizeof(double) + _ids.capacity() * sizeof(uint32_t) + _subgrid.capacity() * sizeof(int32_t) + _subgrids.capacity() * sizeof(Subgrid) + _sub_offsets.capacity() * sizeof(uint32_t);
+    }
+
+    // Call visit(id) for every point inside the (inclusive) box.
+    template <typename TVisit>
+    void query_range(double min_x, double min_y, double max_x, double max_y, TVisit visit) const
+    {
+        scan(min_x, min_y, max_x, max_y, [&](size_t begin, size_t end, bool contained) {
+            if (contained)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    visit(_ids[i]);
+                }
+
+                return;
+            }
+
+            for (; begin < end; begin += REFINE_CHUNK)
+            {
+                size_t n = std::min<size_t>(REFINE_CHUNK, end - begin);
+
+                uint64_t mask[REFINE_CHUNK / 64];
+                refine_range(&_x[begin], &_y[begin], n, min_x, min_y, max_x, max_y, mask);
+                for_each_match(mask, n, [&](size_t j) { visit(_ids[begin + j]); });
+            }
+        });
+    }
+
+    // Call visit(id) for every point within distance d (inclusive) of (x, y).
+    template <typename TVisit>
+    void query_distance(double x, double y, double d, TVisit visit) const
+    {
+        double distance2 = d * d;
+
+        scan(x - d, y - d, x + d, y + d, [&](size_t begin, size_t end, bool contained) {
+            for (; begin < end; begin += REFINE_CHUNK)
+            {
+                size_t n = std::min<size_t>(REFINE_CHUNK, end - begin);
+
+                uint64_t mask[REFINE_CHUNK / 64];
+                refine_distance(&_x[begin], &_y[begin], n, x, y, distance2, mask);
+                for_each_match(mask, n, [&](size_t j) { visit(_ids[begin + j]); });
+            }
+        });
+    }
+
+    // Push the heap.k() points nearest to (x, y) into the heap with their squared distance. Cells are visited in
+    // rings of growing Chebyshev distance around the cell of the query point, until the next ring cannot hold a
+    // point nearer than the k-th nearest found so far.
+    void query_knn(double x, double y, KnnHeap<uint32_t> &heap) const
+    {
+        if (_x.empty())
+        {
+            return;
+        }
+
+        int64_t cx = cell_of(x, _min_x, _cell_size, _nx);
+        int64_t cy = cell_of(y, _min_y, _cell_size, _ny);
+        int64_t nx = _nx, ny = _ny;
+
+        double origin_x = _min_x + cx * _cell_size;
+        double origin_y = _min_y + cy * _cell_size;
+
+        // Cells [first, last] of a row are a single run.
+        auto visit_cells = [&](int64_t row, int64_t first, int64_t last) {
+            for (size_t i = _offsets[row * nx + first]; i < _offsets[row * nx + last + 1]; i++)
+            {
+                double dx = _x[i] - x;
+                double dy = _y[i] - y;
+                heap.push(dx * dx + dy * dy, _ids[i]);
+            }
+        };
+
+        for (int64_t r = 0; r <= std::max(nx, ny); r++)
+        {
+            int64_t first = std::max<int64_t>(cx - r, 0);
+            int64_t last = std::min<int64_t>(cx + r, nx - 1);
+
+            if (cy - r >= 0)
+            {
+                visit_cells(cy - r, first, last);
+            }
+
+            if (r > 0 && cy + r < ny)
+            {
+                visit_cells(cy + r, first, last);
+            }
+
+            for (int64_t row = std::max<int64_t>(cy - r + 1, 0); row <= std::min<int64_t>(cy + r - 1, ny - 1); row++)
+            {
+                if (cx - r >= 0)
+                {
+                    visit_cells(row, cx - r, cx - r);
+                }
+
+                if (cx + r < nx)
+                {
+                    visit_cells(row, cx + r, cx + r);
+                }
+            }
+
+            // Points in ring r + 1 are at least this far away (or anywhere, if the query lies outside the grid).
+            double reach = std::min({x - (origin_x - r * _cell_size), origin_x + (r + 1) * _cell_size - x,
+                                     y - (origin_y - r * _cell_size), origin_y + (r + 1) * _cell_size - y});
+
+            if (reach > 0 && reach * reach >= heap.bound())
+            {
+                break;
+            }
+        }
+    }
+};
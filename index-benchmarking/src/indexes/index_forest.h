@@ -0,0 +1,181 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include "geos/geom/Point.h"
+#include "geos/geom/Envelope.h"
+#include "../utils/parallel.h"
+#include "../utils/hilbert.h"
+
+// GEOS spatial indexes built concurrently over spatially compact parts of the points. The points are cut into
+// n_partitions runs along a Hilbert curve over their extent and every run is inserted into a tree of its own on its
+// own thread. The bounding boxes of the trees stitch them together as a root level, so a query only descends into
+// the trees it overlaps. TIndex needs a default constructor, insert(const Envelope *, void *) and
+// query(const Envelope *, std::vector<void *> &), which all GEOS SpatialIndex implementations provide.
+template <typename TIndex>
+class IndexForest
+{
+private:
+    enum
+    {
+        MIN_BLOCK = 1 << 14,         // smallest block of points handed to a thread
+        SAMPLES_PER_PARTITION = 256, // keys sampled per partition to place the splitters
+    };
+
+    std::vector<std::unique_ptr<TIndex>> _trees;
+    std::vector<geos::geom::Envelope> _extents;
+    size_t _size;
+
+public:
+    // finish(tree) runs on the building thread once all points of a tree were inserted.
+    template <typename TFinish>
+    IndexForest(const std::vector<std::unique_ptr<geos::geom::Point>> &points, unsigned int n_partitions, TFinish finish, std::function<void(size_t, size_t)> progress = [](size_t, size_t) {}) : _size(points.size())
+    {
+        size_t n = points.size();
+        n_partitions = std::max<size_t>(1, std::min<size_t>(n_partitions, n));
+
+        std::vector<geos::geom::Envelope> thread_extents(n_partitions);
+
+        parallel_for(n, n_partitions, [&](size_t begin, size_t end, unsigned int thread_id) {
+            for (size_t i = begin; i < end; i++)
+            {
+                thread_extents[thread_id].expandToInclude(points[i]->getX(), points[i]->getY());
+            }
+        }, MIN_BLOCK);
+
+        geos::geom::Envelope extent;
+
+        for (const auto &thread_extent : thread_extents)
+        {
+            extent.expandToInclude(&thread_extent);
+        }
+
+        HilbertMapper mapper(extent.isNull() ? 0 : extent.getMinX(), extent.isNull() ? 0 : extent.getMinY(),
+                             extent.isNull() ? 0 : extent.getMaxX(), extent.isNull() ? 0 : extent.getMaxY());
+
+        // Splitters between the partitions are quantiles of a regular sample of the keys.
+        size_t n_samples = std::min<size_t>(n, (size_t)SAMPLES_PER_PARTITION * n_partitions);
+        std::vector<uint64_t> sample(n_samples);
+
+        for (size_t s = 0; s < n_samples; s++)
+        {
+            const auto &point = points[s * n / n_samples];
+            sample[s] = mapper(point->getX(), point->getY());
+        }
+
+        std::sort(sample.begin(), sample.end());
+        std::vector<uint64_t> splitters;
+
+        for (size_t p = 1; p < n_partitions; p++)
+        {
+            splitters.push_back(sample[p * n_samples / n_partitions]);
+        }
+
+        // Counting sort of the point ids by partition. Both passes split [0, n) into the same blocks, so every
+        // thread scatters its block to the offsets it counted.
+        std::vector<uint32_t> partition(n);
+        std::vector<std::vector<size_t>> counts(n_partitions, std::vector<size_t>(n_partitions, 0));
+
+        parallel_for(n, n_partitions, [&](size_t begin, size_t end, unsigned int thread_id) {
+            for (size_t i = begin; i < end; i++)
+            {
+                uint64_t key = mapper(points[i]->getX(), points[i]->getY());
+                partition[i] = std::upper_bound(splitters.begin(), splitters.end(), key) - splitters.begin();
+                counts[thread_id][partition[i]]++;
+            }
+        }, MIN_BLOCK);
+
+        std::vector<size_t> partition_offsets(n_partitions + 1, 0);
+        size_t offset = 0;
+
+        for (size_t p = 0; p < n_partitions; p++)
+        {
+            partition_offsets[p] = offset;
+
+            for (size_t t = 0; t < n_partitions; t++)
+            {
+                size_t count = counts[t][p];
+                counts[t][p] = offset;
+                offset += count;
+            }
+        }
+
+        partition_offsets[n_partitions] = offset;
+        std::vector<uint32_t> order(n);
+
+        parallel_for(n, n_partitions, [&](size_t begin, size_t end, unsigned int thread_id) {
+            for (size_t i = begin; i < end; i++)
+            {
+                order[counts[thread_id][partition[i]]++] = i;
+            }
+        }, MIN_BLOCK);
+
+        // One tree per partition, each built by a thread of its own.
+        _trees.resize(n_partitions);
+        _extents.resize(n_partitions);
+        std::atomic<size_t> done(0);
+
+        parallel_for(n_partitions, n_partitions, [&](size_t begin, size_t end, unsigned int thread_id) {
+            for (size_t p = begin; p < end; p++)
+            {
+                auto tree = std::make_unique<TIndex>();
+                size_t inserted = 0;
+
+                for (size_t j = partition_offsets[p]; j < partition_offsets[p + 1]; j++)
+                {
+                    const auto &point = points[order[j]];
+                    tree->insert(point->getEnvelopeInternal(), point.get());
+                    _extents[p].expandToInclude(point->getX(), point->getY());
+
+                    if (++inserted == MIN_BLOCK)
+                    {
+                        progress(done += inserted, n);
+                        inserted = 0;
+                    }
+                }
+
+                finish(*tree);
+                progress(done += inserted, n);
+                _trees[p] = std::move(tree);
+            }
+        });
+    }
+
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+    inline size_t n_partitions() const
+    {
+        return _trees.size();
+    }
+
+    // Number of points in the largest tree, a measure of how evenly the build was spread over the threads.
+    size_t max_partition_size() const
+    {
+        size_t largest = 0;
+
+        for (const auto &tree : _trees)
+        {
+            largest = std::max<size_t>(largest, tree->size());
+        }
+
+        return largest;
+    }
+
+    // Appends the items of every tree whose bounding box intersects the search envelope.
+    void query(const geos::geom::Envelope *search_envelope, std::vector<void *> &items) const
+    {
+        for (size_t p = 0; p < _trees.size(); p++)
+        {
+            if (_extents[p].intersects(search_envelope))
+            {
+                _trees[p]->query(search_envelope, items);
+            }
+        }
+    }
+};
@@ -0,0 +1,252 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "s2_cell_array.h"
+
+// Two-stage recursive model index over a sorted array of 64-bit keys. A linear root model picks one of n_models
+// linear leaf models, which predicts the position of a key. Every leaf model records the smallest and largest
+// prediction error over its keys, so a lookup only binary searches the window [prediction + err_lo, prediction +
+// err_hi + 1] instead of the whole array.
+class LinearRMI
+{
+private:
+    struct Model
+    {
+        uint64_t base;
+        double slope;
+        double intercept;
+        size_t begin; // positions of the keys assigned to this model
+        size_t end;
+        int64_t err_lo;
+        int64_t err_hi;
+    };
+
+    size_t _n;
+    uint64_t _root_base;
+    double _root_slope;
+    double _root_intercept;
+    FlatArray<Model> _models;
+
+    // Signed key offset as a double. Monotone in key, which keeps every prediction monotone.
+    static inline double offset(uint64_t key, uint64_t base)
+    {
+        return key >= base ? (double)(key - base) : -(double)(base - key);
+    }
+
+    // Least-squares fit of position on key over keys[begin, end). Slopes are clamped at 0 to stay monotone.
+    static void fit(const uint64_t *keys, size_t begin, size_t end, uint64_t base, double &slope, double &intercept)
+    {
+        size_t n = end - begin;
+        double mean_x = 0, mean_y = 0;
+
+        for (size_t i = begin; i < end; i++)
+        {
+            mean_x += offset(keys[i], base) / n;
+            mean_y += (double)i / n;
+        }
+
+        double covariance = 0, variance = 0;
+
+        for (size_t i = begin; i < end; i++)
+        {
+            double dx = offset(keys[i], base) - mean_x;
+            covariance += dx * ((double)i - mean_y);
+            variance += dx * dx;
+        }
+
+        slope = variance > 0 ? std::max(0.0, covariance / variance) : 0;
+        intercept = mean_y - slope * mean_x;
+    }
+
+    inline size_t root(uint64_t key) const
+    {
+        double position = _root_intercept + _root_slope * offset(key, _root_base);
+        double model = std::floor(position * _models.size() / std::max<size_t>(1, _n));
+
+        return (size_t)std::min(std::max(model, 0.0), (double)(_models.size() - 1));
+    }
+
+    // Clamped to the model's own positions, which keeps the prediction monotone and within integer range.
+    static inline int64_t predict(const Model &model, uint64_t key)
+    {
+        double position = model.intercept + model.slope * offset(key, model.base);
+        return (int64_t)std::floor(std::min(std::max(position, (double)model.begin), (double)model.end));
+    }
+
+public:
+    LinearRMI(const uint64_t *keys, size_t n, size_t n_models) : _n(n), _root_base(n > 0 ? keys[0] : 0), _root_slope(0), _root_intercept(0)
+    {
+        _models.resize(std::max<size_t>(1, n_models));
+
+        if (n == 0)
+        {
+            for (auto &model : _models)
+            {
+                model = {0, 0, 0, 0, 0, 0, 0};
+            }
+
+            return;
+        }
+
+        fit(keys, 0, n, _root_base, _root_slope, _root_intercept);
+
+        // The root is monotone, so every leaf model receives a contiguous run of keys.
+        size_t position = 0;
+
+        for (size_t m = 0; m < _models.size(); m++)
+        {
+            auto &model = _models[m];
+            model.begin = position;
+
+            while (position < n && root(keys[position]) == m)
+            {
+                position++;
+            }
+
+            model.end = position;
+            model.base = model.begin < n ? keys[model.begin] : keys[n - 1];
+
+            if (model.end == model.begin)
+            {
+                model.slope = 0;
+                model.intercept = model.begin;
+                model.err_lo = 0;
+                model.err_hi = 0;
+                continue;
+            }
+
+            fit(keys, model.begin, model.end, model.base, model.slope, model.intercept);
+
+            model.err_lo = INT64_MAX;
+            model.err_hi = INT64_MIN;
+
+            for (size_t i = model.begin; i < model.end; i++)
+            {
+                int64_t error = (int64_t)i - predict(model, keys[i]);
+                model.err_lo = std::min(model.err_lo, error);
+                model.err_hi = std::max(model.err_hi, error);
+            }
+        }
+    }
+
+    // Maps the models of a snapshot written by save().
+    LinearRMI(SnapshotReader &reader) : _n(reader.value<size_t>()), _root_base(reader.value<uint64_t>()), _root_slope(reader.value<double>()), _root_intercept(reader.value<double>()), _models(reader.array<Model>()){};
+
+    void save(SnapshotWriter &writer) const
+    {
+        writer.value(_n);
+        writer.value(_root_base);
+        writer.value(_root_slope);
+        writer.value(_root_intercept);
+        writer.array(_models);
+    }
+
+    // First position >= begin whose key is >= key. keys must be the array the model was trained on.
+    size_t lower_bound(const uint64_t *keys, uint64_t key, size_t begin = 0) const
+    {
+        const auto &model = _models[root(key)];
+        int64_t prediction = predict(model, key);
+
+        // The answer always lies within the model's own positions, see the class comment for the window.
+        size_t lo = (size_t)std::min<int64_t>(model.end, std::max<int64_t>(model.begin, prediction + model.err_lo));
+        size_t hi = (size_t)std::max<int64_t>(lo, std::min<int64_t>(model.end, prediction + model.err_hi + 1));
+
+        size_t position = std::lower_bound(keys + lo, keys + hi, key) - keys;
+        return std::max(position, begin);
+    }
+
+    inline size_t n_models() const
+    {
+        return _models.size();
+    }
+
+    size_t bytes() const
+    {
+        return sizeof(*this) + _models.capacity() * sizeof(Model);
+    }
+
+    // Largest search window over all models.
+    size_t max_error() const
+    {
+        int64_t error = 0;
+
+        for (const auto &model : _models)
+        {
+            error = std::max(error, model.err_hi - model.err_lo + 1);
+        }
+
+        return error;
+    }
+
+    // Search window averaged over all keys.
+    double mean_error() const
+    {
+        double error = 0;
+
+        for (const auto &model : _models)
+        {
+            error += (double)(model.end - model.begin) * (model.err_hi - model.err_lo + 1) / std::max<size_t>(1, _n);
+        }
+
+        return error;
+    }
+};
+
+// S2CellArray whose binary searches are replaced by LinearRMI lookups.
+class LearnedCellIndex
+{
+public:
+    enum
+    {
+        SNAPSHOT_VERSION = 1,
+    };
+
+private:
+    S2CellArray _array;
+    LinearRMI _model;
+
+public:
+    LearnedCellIndex(const std::vector<S2Point> &points, size_t keys_per_model = 1024) : _array(points), _model(_array.cells(), _array.size(), std::max<size_t>(1, points.size() / std::max<size_t>(1, keys_per_model))){};
+
+    // Maps the cell array and models of a snapshot written by save().
+    LearnedCellIndex(SnapshotReader &reader) : _array(reader), _model(reader){};
+
+    static const char *snapshot_kind()
+    {
+        return "learned_cells";
+    }
+
+    void save(SnapshotWriter &writer) const
+    {
+        _array.save(writer);
+        _model.save(writer);
+    }
+
+    inline size_t size() const
+    {
+        return _array.size();
+    }
+
+    inline const LinearRMI &model() const
+    {
+        return _model;
+    }
+
+    size_t bytes() const
+    {
+        return _array.bytes() + _model.bytes();
+    }
+
+    template <typename TRegion, typename TVisit>
+    void query(const TRegion &region, S2RegionCoverer &coverer, std::vector<S2CellId> &covering, TVisit visit) const
+    {
+        _array.query(region, coverer, covering, visit, [this](uint64_t key, size_t begin) { return _model.lower_bound(_array.cells(), key, begin); });
+    }
+
+    void query_knn(const S2Point &point, S2RegionCoverer &coverer, std::vector<S2CellId> &covering, KnnHeap<uint32_t> &heap) const
+    {
+        _array.query_knn(point, coverer, covering, heap, [this](uint64_t key, size_t begin) { return _model.lower_bound(_array.cells(), key, begin); });
+    }
+};
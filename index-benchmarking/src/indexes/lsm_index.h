@@ -0,0 +1,473 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include "packed_rtree.h"
+#include "../utils/refine.h"
+#include "../utils/knn.h"
+
+// Write-optimized point index in the style of a log-structured merge tree. Updates are appended to a small mutable
+// buffer, which is frozen once full and merged by a background thread into a stack of immutable packed R-trees whose
+// sizes grow by size_ratio from the newest level to the oldest. Queries search every level and buffer.
+//
+// Every write of a point gets a new sequence number, and a table of the latest sequence number per id decides which
+// copy of a point is current: the copies that moves leave behind in older levels are skipped by queries and dropped
+// by the next merge that reads them. A removal writes a tombstone into that table, so it needs no record in the
+// levels and takes effect at once. Ids lie in [0, n_ids).
+//
+// Updates come from a single thread. Queries may run concurrently with each other and with the background merge,
+// but not with updates.
+class LsmPointIndex
+{
+public:
+    enum
+    {
+        DEFAULT_BUFFER_CAPACITY = 1 << 12,
+        DEFAULT_SIZE_RATIO = 4,
+        MAX_FROZEN_BUFFERS = 4, // updates stall while this many buffers wait to be merged
+    };
+
+private:
+    static const uint64_t TOMBSTONE = uint64_t(1) << 63;
+
+    // Points as structure-of-arrays, in write order.
+    struct Run
+    {
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<uint32_t> ids;
+        std::vector<uint64_t> sequences;
+
+        inline size_t size() const
+        {
+            return ids.size();
+        }
+
+        void reserve(size_t n)
+        {
+            x.reserve(n);
+            y.reserve(n);
+            ids.reserve(n);
+            sequences.reserve(n);
+        }
+
+        void push_back(double px, double py, uint32_t id, uint64_t sequence)
+        {
+            x.push_back(px);
+            y.push_back(py);
+            ids.push_back(id);
+            sequences.push_back(sequence);
+        }
+
+        size_t bytes() const
+        {
+            return (x.capacity() + y.capacity()) * sizeof(double) + ids.capacity() * sizeof(uint32_t) + sequences.capacity() * sizeof(uint64_t);
+        }
+    };
+
+    // Immutable level. The tree holds the coordinates in leaf order; its ids are positions in ids and sequences.
+    struct Level
+    {
+        PackedRTree tree;
+        std::vector<uint32_t> ids;
+        std::vector<uint64_t> sequences;
+
+        Level(Run &&run) : tree(run.x.data(), run.y.data(), run.size()), ids(std::move(run.ids)), sequences(std::move(run.sequences)){};
+
+        size_t bytes() const
+        {
+            return tree.bytes() + ids.capacity() * sizeof(uint32_t) + sequences.capacity() * sizeof(uint64_t);
+        }
+    };
+
+    // Levels and frozen buffers, replaced as a whole so that a query always sees every point exactly once.
+    struct State
+    {
+        std::vector<std::shared_ptr<const Level>> levels; // oldest (largest) first
+        std::vector<std::shared_ptr<const Run>> frozen;   // oldest first
+    };
+
+    size_t _buffer_capacity;
+    size_t _size_ratio;
+
+    size_t _n_ids;
+    std::unique_ptr<std::atomic<uint64_t>[]> _latest;
+    uint64_t _next_sequence = 1;
+    size_t _size;
+
+    // Bounding box of every point ever written, for sizing the kNN search window.
+    double _min_x, _min_y, _max_x, _max_y;
+
+    Run _buffer;
+
+    // Read with std::atomic_load. Replaced under _state_mutex, by the updating thread when it freezes the buffer and
+    // by the merger when it installs a new level.
+    std::shared_ptr<const State> _state;
+    std::mutex _state_mutex;
+    std::condition_variable _merge_needed;
+    std::condition_variable _merge_done;
+    bool _stop = false;
+    std::atomic<size_t> _n_merges;
+    std::thread _merger;
+
+    inline bool current(uint32_t id, uint64_t sequence) const
+    {
+        return _latest[id].load(std::memory_order_relaxed) == sequence;
+    }
+
+    void expand_extent(double x, double y)
+    {
+        _min_x = std::min(_min_x, x);
+        _min_y = std::min(_min_y, y);
+        _max_x = std::max(_max_x, x);
+        _max_y = std::max(_max_y, y);
+    }
+
+    // Append the current points of a run or level to merged.
+    void append_current(const Run &run, Run &merged) const
+    {
+        for (size_t i = 0; i < run.size(); i++)
+        {
+            if (current(run.ids[i], run.sequences[i]))
+            {
+                merged.push_back(run.x[i], run.y[i], run.ids[i], run.sequences[i]);
+            }
+        }
+    }
+
+    void append_current(const Level &level, Run &merged) const
+    {
+        for (size_t i = 0; i < level.tree.size(); i++)
+        {
+            auto p = level.tree.ids()[i];
+
+            if (current(level.ids[p], level.sequences[p]))
+            {
+                merged.push_back(level.tree.x()[i], level.tree.y()[i], level.ids[p], level.sequences[p]);
+            }
+        }
+    }
+
+    // Merge all frozen buffers into a new level, together with every newer level that is less than size_ratio
+    // times as large as the merged points so far. Writers keep appending frozen buffers meanwhile.
+    void merge_loop()
+    {
+        std::unique_lock<std::mutex> lock(_state_mutex);
+
+        while (true)
+        {
+            _merge_needed.wait(lock, [this] { return _stop || !_state->frozen.empty(); });
+
+            if (_stop)
+            {
+                return;
+            }
+
+            auto state = _state;
+            lock.unlock();
+
+            Run merged;
+
+            for (const auto &run : state->frozen)
+            {
+                append_current(*run, merged);
+            }
+
+            auto levels = state->levels;
+
+            while (!levels.empty() && levels.back()->tree.size() < _size_ratio * std::max<size_t>(1, merged.size()))
+            {
+                append_current(*levels.back(), merged);
+                levels.pop_back();
+            }
+
+            if (merged.size() > 0)
+            {
+                levels.push_back(std::make_shared<const Level>(std::move(merged)));
+            }
+
+            lock.lock();
+
+            auto next = std::make_shared<State>();
+            next->levels = std::move(levels);
+            next->frozen.assign(_state->frozen.begin() + state->frozen.size(), _state->frozen.end());
+
+            std::atomic_store(&_state, std::shared_ptr<const State>(next));
+            _n_merges++;
+            _merge_done.notify_all();
+        }
+    }
+
+    void freeze()
+    {
+        auto frozen = std::make_shared<const Run>(std::move(_buffer));
+        _buffer = Run();
+        _buffer.reserve(_buffer_capacity);
+
+        std::unique_lock<std::mutex> lock(_state_mutex);
+
+        // Bounds the number of unsorted runs a query has to scan when the merger falls behind.
+        _merge_done.wait(lock, [this] { return _state->frozen.size() < MAX_FROZEN_BUFFERS; });
+
+        auto next = std::make_shared<State>(*_state);
+        next->frozen.push_back(frozen);
+
+        std::atomic_store(&_state, std::shared_ptr<const State>(next));
+        _merge_needed.notify_one();
+    }
+
+    // Run the refinement kernel over a run in blocks and call visit(id, x, y) for every current match.
+    template <typename TRefine, typename TVisit>
+    void scan(const Run &run, TRefine &refine, TVisit &visit) const
+    {
+        uint64_t mask[PackedRTree::MAX_NODE_CAPACITY / 64];
+
+        for (size_t begin = 0; begin < run.size(); begin += PackedRTree::MAX_NODE_CAPACITY)
+        {
+            size_t n = std::min<size_t>(PackedRTree::MAX_NODE_CAPACITY, run.size() - begin);
+            refine(&run.x[begin], &run.y[begin], n, mask);
+
+            for_each_match(mask, n, [&](size_t j) {
+                if (current(run.ids[begin + j], run.sequences[begin + j]))
+                {
+                    visit(run.ids[begin + j], run.x[begin + j], run.y[begin + j]);
+                }
+            });
+        }
+    }
+
+    // Search every level with node_test and refine, then scan the buffers.
+    template <typename TNodeTest, typename TRefine, typename TVisit>
+    void search(TNodeTest node_test, TRefine refine, TVisit visit) const
+    {
+        auto state = std::atomic_load(&_state);
+
+        for (const auto &level : state->levels)
+        {
+            const auto &tree = level->tree;
+
+            tree.search(node_test, [&](size_t begin, size_t end) {
+                uint64_t mask[PackedRTree::MAX_NODE_CAPACITY / 64];
+                refine(&tree.x()[begin], &tree.y()[begin], end - begin, mask);
+
+                for_each_match(mask, end - begin, [&](size_t j) {
+                    auto p = tree.ids()[begin + j];
+
+                    if (current(level->ids[p], level->sequences[p]))
+                    {
+                        visit(level->ids[p], tree.x()[begin + j], tree.y()[begin + j]);
+                    }
+                });
+            });
+        }
+
+        for (const auto &run : state->frozen)
+        {
+            scan(*run, refine, visit);
+        }
+
+        scan(_buffer, refine, visit);
+    }
+
+public:
+    // Bulk-load points 0 to n - 1 into a single level and start the merger.
+    LsmPointIndex(const double *x, const double *y, size_t n, size_t buffer_capacity = DEFAULT_BUFFER_CAPACITY, size_t size_ratio = DEFAULT_SIZE_RATIO)
+        : _buffer_capacity(std::max<size_t>(1, buffer_capacity)), _size_ratio(std::max<size_t>(2, size_ratio)), _n_ids(n), _latest(new std::atomic<uint64_t>[n]), _size(n), _n_merges(0)
+    {
+        const double inf = std::numeric_limits<double>::infinity();
+        _min_x = _min_y = inf;
+        _max_x = _max_y = -inf;
+
+        Run run;
+        run.reserve(n);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            _latest[i].store(0, std::memory_order_relaxed);
+            run.push_back(x[i], y[i], i, 0);
+            expand_extent(x[i], y[i]);
+        }
+
+        auto state = std::make_shared<State>();
+
+        if (n > 0)
+        {
+            state->levels.push_back(std::make_shared<const Level>(std::move(run)));
+        }
+
+        _state = state;
+        _buffer.reserve(_buffer_capacity);
+        _merger = std::thread(&LsmPointIndex::merge_loop, this);
+    }
+
+    LsmPointIndex(const LsmPointIndex &) = delete;
+    LsmPointIndex &operator=(const LsmPointIndex &) = delete;
+
+    ~LsmPointIndex()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_state_mutex);
+            _stop = true;
+        }
+
+        _merge_needed.notify_one();
+        _merger.join();
+    }
+
+    // Insert point id at (x, y), or move it there if it is present.
+    void insert(uint32_t id, double x, double y)
+    {
+        uint64_t sequence = _next_sequence++;
+
+        if (_latest[id].load(std::memory_order_relaxed) & TOMBSTONE)
+        {
+            _size++;
+        }
+
+        _buffer.push_back(x, y, id, sequence);
+        _latest[id].store(sequence, std::memory_order_relaxed);
+        expand_extent(x, y);
+
+        if (_buffer.size() >= _buffer_capacity)
+        {
+            freeze();
+        }
+    }
+
+    void remove(uint32_t id)
+    {
+        if (!(_latest[id].load(std::memory_order_relaxed) & TOMBSTONE))
+        {
+            _latest[id].store(_next_sequence++ | TOMBSTONE, std::memory_order_relaxed);
+            _size--;
+        }
+    }
+
+    // Block until every frozen buffer has been merged.
+    void wait_for_merges()
+    {
+        std::unique_lock<std::mutex> lock(_state_mutex);
+        _merge_done.wait(lock, [this] { return _state->frozen.empty(); });
+    }
+
+    // Number of current points.
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+    inline size_t buffer_capacity() const
+    {
+        return _buffer_capacity;
+    }
+
+    inline size_t size_ratio() const
+    {
+        return _size_ratio;
+    }
+
+    size_t n_levels() const
+    {
+        return std::atomic_load(&_state)->levels.size();
+    }
+
+    size_t n_merges() const
+    {
+        return _n_merges.load();
+    }
+
+    size_t bytes() const
+    {
+        auto state = std::atomic_load(&_state);
+        size_t bytes = sizeof(*this) + _n_ids * sizeof(uint64_t) + _buffer.bytes();
+
+        for (const auto &level : state->levels)
+        {
+            bytes += level->bytes();
+        }
+
+        for (const auto &run : state->frozen)
+        {
+            bytes += run->bytes();
+        }
+
+        return bytes;
+    }
+
+    // Call visit(id) for every point inside the (inclusive) box.
+    template <typename TVisit>
+    void query_range(double min_x, double min_y, double max_x, double max_y, TVisit visit) const
+    {
+        search(
+            [=](double n_min_x, double n_min_y, double n_max_x, double n_max_y) {
+                return n_min_x <= max_x && n_max_x >= min_x && n_min_y <= max_y && n_max_y >= min_y;
+            },
+            [=](const double *x, const double *y, size_t n, uint64_t *mask) {
+                refine_range(x, y, n, min_x, min_y, max_x, max_y, mask);
+            },
+            [&](uint32_t id, double x, double y) { visit(id); });
+    }
+
+    // Call visit(id) for every point within the given distance of (x, y).
+    template <typename TVisit>
+    void query_distance(double x, double y, double distance, TVisit visit) const
+    {
+        double distance2 = distance * distance;
+
+        search(
+            [=](double n_min_x, double n_min_y, double n_max_x, double n_max_y) {
+                double dx = std::max(std::max(n_min_x - x, x - n_max_x), 0.0);
+                double dy = std::max(std::max(n_min_y - y, y - n_max_y), 0.0);
+                return dx * dx + dy * dy <= distance2;
+            },
+            [=](const double *px, const double *py, size_t n, uint64_t *mask) {
+                refine_distance(px, py, n, x, y, distance2, mask);
+            },
+            [&](uint32_t id, double px, double py) { visit(id); });
+    }
+
+    // Push the heap.k() points nearest to (x, y) into the heap with their squared distance. Stale copies rule out a
+    // per-level best-first search, so a square window is searched instead, starting at the size that holds k points
+    // at the mean density and growing until k points lie within its inscribed circle.
+    void query_knn(double x, double y, KnnHeap<uint32_t> &heap) const
+    {
+        if (_size == 0)
+        {
+            return;
+        }
+
+        double area = (_max_x - _min_x) * (_max_y - _min_y);
+        double radius = std::max(1.0, 0.5 * std::sqrt(heap.k() * area / _size));
+
+        while (true)
+        {
+            heap.clear();
+
+            search(
+                [=](double n_min_x, double n_min_y, double n_max_x, double n_max_y) {
+                    return n_min_x <= x + radius && n_max_x >= x - radius && n_min_y <= y + radius && n_max_y >= y - radius;
+                },
+                [=](const double *px, const double *py, size_t n, uint64_t *mask) {
+                    refine_range(px, py, n, x - radius, y - radius, x + radius, y + radius, mask);
+                },
+                [&](uint32_t id, double px, double py) { heap.push((px - x) * (px - x) + (py - y) * (py - y), id); });
+
+            bool covers_extent = x - radius <= _min_x && x + radius >= _max_x && y - radius <= _min_y && y + radius >= _max_y;
+
+            if ((heap.full() && heap.bound() <= radius * radius) || covers_extent)
+            {
+                return;
+            }
+
+            // With k candidates in hand, their farthest distance bounds the final radius. It is rounded up, so that the
+            // next window is the last even if squaring the root rounds down.
+            radius = heap.full() ? std::nextafter(std::sqrt(heap.bound()), std::numeric_limits<double>::infinity()) : 2 * radius;
+        }
+    }
+};
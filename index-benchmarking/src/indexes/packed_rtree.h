@@ -0,0 +1,384 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include "../utils/hilbert.h"
+#include "../utils/refine.h"
+#include "../utils/knn.h"
+#include "../utils/flat_array.h"
+#include "../utils/snapshot.h"
+
+// Static R-tree over points, bulk-loaded into a handful of contiguous arrays. Points are kept inline in leaf order
+// as structure-of-arrays, so a leaf is a run of node_capacity consecutive x, y and id values. Node bounding boxes
+// are stored structure-of-arrays as well, level by level from the leaves up: the children of node j on level l are
+// nodes [j * node_capacity, (j + 1) * node_capacity) on level l - 1.
+class PackedRTree
+{
+public:
+    enum SortOrder
+    {
+        STR,
+        HILBERT,
+    };
+
+    // Upper bound on the node capacity, so a leaf's refinement mask fits on the stack.
+    enum
+    {
+        MAX_NODE_CAPACITY = 256,
+        SNAPSHOT_VERSION = 1,
+    };
+
+private:
+    size_t _node_capacity;
+
+    // Points in leaf order.
+    FlatArray<double> _x;
+    FlatArray<double> _y;
+    FlatArray<uint32_t> _ids;
+
+    // Node boxes. Level l occupies [_level_offsets[l], _level_offsets[l + 1]), level 0 holds the leaves.
+    FlatArray<double> _min_x;
+    FlatArray<double> _min_y;
+    FlatArray<double> _max_x;
+    FlatArray<double> _max_y;
+    FlatArray<size_t> _level_offsets;
+
+    void add_node(double min_x, double min_y, double max_x, double max_y)
+    {
+        _min_x.push_back(min_x);
+        _min_y.push_back(min_y);
+        _max_x.push_back(max_x);
+        _max_y.push_back(max_y);
+    }
+
+    void build_levels()
+    {
+        const double inf = std::numeric_limits<double>::infinity();
+        size_t n = _x.size();
+
+        // Leaves.
+        _level_offsets.push_back(0);
+
+        for (size_t begin = 0; begin < n; begin += _node_capacity)
+        {
+            double min_x = inf, min_y = inf, max_x = -inf, max_y = -inf;
+
+            for (size_t i = begin; i < std::min(n, begin + _node_capacity); i++)
+            {
+                min_x = std::min(min_x, _x[i]);
+                min_y = std::min(min_y, _y[i]);
+                max_x = std::max(max_x, _x[i]);
+                max_y = std::max(max_y, _y[i]);
+            }
+
+            add_node(min_x, min_y, max_x, max_y);
+        }
+
+        _level_offsets.push_back(_min_x.size());
+
+        // Inner levels, until a single root remains.
+        while (level_size(n_levels() - 1) > 1)
+        {
+            size_t child_begin = _level_offsets[n_levels() - 1];
+            size_t child_end = _level_offsets[n_levels()];
+
+            for (size_t begin = child_begin; begin < child_end; begin += _node_capacity)
+            {
+                double min_x = inf, min_y = inf, max_x = -inf, max_y = -inf;
+
+                for (size_t c = begin; c < std::min(child_end, begin + _node_capacity); c++)
+                {
+                    min_x = std::min(min_x, _min_x[c]);
+                    min_y = std::min(min_y, _min_y[c]);
+                    max_x = std::max(max_x, _max_x[c]);
+                    max_y = std::max(max_y, _max_y[c]);
+                }
+
+                add_node(min_x, min_y, max_x, max_y);
+            }
+
+            _level_offsets.push_back(_min_x.size());
+        }
+    }
+
+    template <typename TNodeTest, typename TLeafVisit>
+    void search(size_t level, size_t node, TNodeTest &node_test, TLeafVisit &leaf_visit) const
+    {
+        if (level == 0)
+        {
+            size_t begin = node * _node_capacity;
+            leaf_visit(begin, std::min(_x.size(), begin + _node_capacity));
+            return;
+        }
+
+        size_t child_offset = _level_offsets[level - 1];
+        size_t child_begin = node * _node_capacity;
+        size_t child_end = std::min(level_size(level - 1), child_begin + _node_capacity);
+
+        for (size_t c = child_begin; c < child_end; c++)
+        {
+            size_t g = child_offset + c;
+
+            if (node_test(_min_x[g], _min_y[g], _max_x[g], _max_y[g]))
+            {
+                search(level - 1, c, node_test, leaf_visit);
+            }
+        }
+    }
+
+    static inline double box_distance2(double x, double y, double min_x, double min_y, double max_x, double max_y)
+    {
+        double dx = std::max(std::max(min_x - x, x - max_x), 0.0);
+        double dy = std::max(std::max(min_y - y, y - max_y), 0.0);
+        return dx * dx + dy * dy;
+    }
+
+public:
+    // Leaf order of the points: sort on x, then on y within vertical slices (sort-tile-recursive).
+    static std::vector<uint32_t> sort_str(const double *x, const double *y, size_t n, size_t node_capacity)
+    {
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+
+        std::sort(order.begin(), order.end(), [x](uint32_t a, uint32_t b) { return x[a] < x[b]; });
+
+        // Cut the x-sorted points into sqrt(#leaves) vertical slices and sort every slice on y.
+        size_t n_leaves = (n + node_capacity - 1) / node_capacity;
+        size_t slice_size = node_capacity * (size_t)std::ceil(std::sqrt((double)n_leaves));
+
+        for (size_t begin = 0; begin < n; begin += slice_size)
+        {
+            auto end = order.begin() + std::min(n, begin + slice_size);
+            std::sort(order.begin() + begin, end, [y](uint32_t a, uint32_t b) { return y[a] < y[b]; });
+        }
+
+        return order;
+    }
+
+    // Leaf order of the points along a Hilbert curve over their extent.
+    static std::vector<uint32_t> sort_hilbert(const double *x, const double *y, size_t n)
+    {
+        auto x_range = std::minmax_element(x, x + n);
+        auto y_range = std::minmax_element(y, y + n);
+        HilbertMapper hilbert(*x_range.first, *y_range.first, *x_range.second, *y_range.second);
+
+        std::vector<uint64_t> keys(n);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            keys[i] = hilbert(x[i], y[i]);
+        }
+
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+        return order;
+    }
+
+    PackedRTree(const double *x, const double *y, size_t n, SortOrder sort_order = STR, size_t node_capacity = 16) : _node_capacity(std::max<size_t>(2, std::min<size_t>(MAX_NODE_CAPACITY, node_capacity)))
+    {
+        std::vector<uint32_t> order;
+
+        if (n > 0)
+        {
+            order = sort_order == HILBERT ? sort_hilbert(x, y, n) : sort_str(x, y, n, _node_capacity);
+        }
+
+        _x.reserve(n);
+        _y.reserve(n);
+        _ids.reserve(n);
+
+        for (auto i : order)
+        {
+            _x.push_back(x[i]);
+            _y.push_back(y[i]);
+            _ids.push_back(i);
+        }
+
+        build_levels();
+    }
+
+    // Maps the arrays of a snapshot written by save().
+    PackedRTree(SnapshotReader &reader) : _node_capacity(reader.value<size_t>()), _x(reader.array<double>()), _y(reader.array<double>()), _ids(reader.array<uint32_t>()),
+                                          _min_x(reader.array<double>()), _min_y(reader.array<double>()), _max_x(reader.array<double>()), _max_y(reader.array<double>()), _level_offsets(reader.array<size_t>()){};
+
+    static const char *snapshot_kind()
+    {
+        return "packed_rtree";
+    }
+
+    void save(SnapshotWriter &writer) const
+    {
+        writer.value(_node_capacity);
+        writer.array(_x);
+        writer.array(_y);
+        writer.array(_ids);
+        writer.array(_min_x);
+        writer.array(_min_y);
+        writer.array(_max_x);
+        writer.array(_max_y);
+        writer.array(_level_offsets);
+    }
+
+    inline size_t size() const
+    {
+        return _x.size();
+    }
+
+    inline size_t node_capacity() const
+    {
+        return _node_capacity;
+    }
+
+    inline size_t n_levels() const
+    {
+        return _level_offsets.size() - 1;
+    }
+
+    inline size_t level_size(size_t level) const
+    {
+        return _level_offsets[level + 1] - _level_offsets[level];
+    }
+
+    size_t bytes() const
+    {
+        return sizeof(*this) +
+               (_x.capacity() + _y.capacity() + _min_x.capacity() + _min_y.capacity() + _max_x.capacity() + _max_y.capacity()) * sizeof(double) +
+               _ids.capacity() * sizeof(uint32_t) +
+               _level_offsets.capacity() * sizeof(size_t);
+    }
+
+    // Visit every leaf whose box passes node_test on all levels. leaf_visit(begin, end) receives the range of the
+    // leaf's points in x(), y() and ids().
+    template <typename TNodeTest, typename TLeafVisit>
+    void search(TNodeTest node_test, TLeafVisit leaf_visit) const
+    {
+        if (size() == 0)
+        {
+            return;
+        }
+
+        size_t root = _level_offsets[n_levels() - 1];
+
+        if (node_test(_min_x[root], _min_y[root], _max_x[root], _max_y[root]))
+        {
+            search(n_levels() - 1, 0, node_test, leaf_visit);
+        }
+    }
+
+    // Call visit(id) for every point inside the (inclusive) box.
+    template <typename TVisit>
+    void query_range(double min_x, double min_y, double max_x, double max_y, TVisit visit) const
+    {
+        search(
+            [=](double n_min_x, double n_min_y, double n_max_x, double n_max_y) {
+                return n_min_x <= max_x && n_max_x >= min_x && n_min_y <= max_y && n_max_y >= min_y;
+            },
+            [&](size_t begin, size_t end) {
+                uint64_t mask[MAX_NODE_CAPACITY / 64];
+                refine_range(&_x[begin], &_y[begin], end - begin, min_x, min_y, max_x, max_y, mask);
+                for_each_match(mask, end - begin, [&](size_t j) { visit(_ids[begin + j]); });
+            });
+    }
+
+    // Call visit(id) for every point within the given distance of (x, y).
+    template <typename TVisit>
+    void query_distance(double x, double y, double distance, TVisit visit) const
+    {
+        double distance2 = distance * distance;
+
+        search(
+            [=](double n_min_x, double n_min_y, double n_max_x, double n_max_y) {
+                return box_distance2(x, y, n_min_x, n_min_y, n_max_x, n_max_y) <= distance2;
+            },
+            [&](size_t begin, size_t end) {
+                uint64_t mask[MAX_NODE_CAPACITY / 64];
+                refine_distance(&_x[begin], &_y[begin], end - begin, x, y, distance2, mask);
+                for_each_match(mask, end - begin, [&](size_t j) { visit(_ids[begin + j]); });
+            });
+    }
+
+    // Push the heap.k() points nearest to (x, y) into the heap with their squared distance. Best-first search: nodes
+    // are expanded in order of their distance to the query point until the nearest unexpanded node lies beyond the
+    // k-th nearest point found so far.
+    void query_knn(double x, double y, KnnHeap<uint32_t> &heap) const
+    {
+        if (size() == 0)
+        {
+            return;
+        }
+
+        // Min-heap of (squared box distance, level, node).
+        struct Entry
+        {
+            double distance2;
+            size_t level;
+            size_t node;
+
+            bool operator<(const Entry &other) const
+            {
+                return distance2 > other.distance2;
+            }
+        };
+
+        std::vector<Entry> queue;
+        size_t root = _level_offsets[n_levels() - 1];
+        queue.push_back({box_distance2(x, y, _min_x[root], _min_y[root], _max_x[root], _max_y[root]), n_levels() - 1, 0});
+
+        while (!queue.empty() && queue.front().distance2 < heap.bound())
+        {
+            auto entry = queue.front();
+            std::pop_heap(queue.begin(), queue.end());
+            queue.pop_back();
+
+            if (entry.level == 0)
+            {
+                size_t begin = entry.node * _node_capacity;
+
+                for (size_t i = begin; i < std::min(_x.size(), begin + _node_capacity); i++)
+                {
+                    double dx = _x[i] - x;
+                    double dy = _y[i] - y;
+                    heap.push(dx * dx + dy * dy, _ids[i]);
+                }
+
+                continue;
+            }
+
+            size_t child_offset = _level_offsets[entry.level - 1];
+            size_t child_begin = entry.node * _node_capacity;
+            size_t child_end = std::min(level_size(entry.level - 1), child_begin + _node_capacity);
+
+            for (size_t c = child_begin; c < child_end; c++)
+            {
+                size_t g = child_offset + c;
+                double distance2 = box_distance2(x, y, _min_x[g], _min_y[g], _max_x[g], _max_y[g]);
+
+                if (distance2 < heap.bound())
+                {
+                    queue.push_back({distance2, entry.level - 1, c});
+                    std::push_heap(queue.begin(), queue.end());
+                }
+            }
+        }
+    }
+
+    inline const double *x() const
+    {
+        return _x.data();
+    }
+
+    inline const double *y() const
+    {
+        return _y.data();
+    }
+
+    inline const uint32_t *ids() const
+    {
+        return _ids.data();
+    }
+};
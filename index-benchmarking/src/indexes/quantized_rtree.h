@@ -0,0 +1,428 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "packed_rtree.h"
+
+// Maps the coordinates of a data set to 32-bit fixed point around the centre of its extent, q = round((v - offset) /
+// scale), with one scale for both axes so that the extent fills the int32 range (about 0.07 mm for 300 km). Every step
+// of the mapping is monotone, so q(a) < q(b) implies a < b, and a point lies within scale / 2 of its dequantized
+// position on either axis.
+class Quantizer
+{
+private:
+    double _offset_x = 0;
+    double _offset_y = 0;
+    double _scale = 1;
+
+    inline int64_t quantize(double value, double offset) const
+    {
+        // Clamped, so that query bounds far outside the data set do not overflow.
+        return std::llround(std::max(-4e18, std::min(4e18, (value - offset) / _scale)));
+    }
+
+public:
+    Quantizer(){};
+
+    Quantizer(const double *x, const double *y, size_t n)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+
+        auto x_range = std::minmax_element(x, x + n);
+        auto y_range = std::minmax_element(y, y + n);
+        double extent = std::max(*x_range.second - *x_range.first, *y_range.second - *y_range.first);
+
+        _offset_x = (*x_range.first + *x_range.second) / 2;
+        _offset_y = (*y_range.first + *y_range.second) / 2;
+
+        // Slightly below 2^32 steps, so that rounding never leaves the int32 range.
+        _scale = extent > 0 ? extent / 4294000000.0 : 1;
+    }
+
+    inline int64_t x(double value) const
+    {
+        return quantize(value, _offset_x);
+    }
+
+    inline int64_t y(double value) const
+    {
+        return quantize(value, _offset_y);
+    }
+
+    inline double dequantize_x(int64_t q) const
+    {
+        return _offset_x + q * _scale;
+    }
+
+    inline double dequantize_y(int64_t q) const
+    {
+        return _offset_y + q * _scale;
+    }
+
+    inline double scale() const
+    {
+        return _scale;
+    }
+
+    // Upper bound on the distance between a point and its dequantized position: scale / sqrt(2), rounded up to a full
+    // step, plus the floating point error of computing either position.
+    inline double max_error() const
+    {
+        return _scale + 1e-14 * (std::abs(_offset_x) + std::abs(_offset_y) + 4.3e9 * _scale);
+    }
+};
+
+// Static R-tree over points like PackedRTree, but with quantized int32 coordinates in its leaves and node boxes,
+// which halves their size. Queries decide on the quantized coordinates wherever these are conclusive, and only read
+// the exact coordinates of a point from the source when it lies within one quantization step of the query boundary.
+// TSource provides the exact coordinates by point id through x(id) and y(id), equal to those the index was built from.
+template <typename TSource>
+class QuantizedRTree
+{
+private:
+    TSource _source;
+    Quantizer _quantizer;
+    size_t _node_capacity;
+
+    // Quantized points in leaf order.
+    std::vector<int32_t> _x;
+    std::vector<int32_t> _y;
+    std::vector<uint32_t> _ids;
+
+    // Quantized node boxes, laid out level by level as in PackedRTree.
+    std::vector<int32_t> _min_x;
+    std::vector<int32_t> _min_y;
+    std::vector<int32_t> _max_x;
+    std::vector<int32_t> _max_y;
+    std::vector<size_t> _level_offsets;
+
+    void add_node(int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y)
+    {
+        _min_x.push_back(min_x);
+        _min_y.push_back(min_y);
+        _max_x.push_back(max_x);
+        _max_y.push_back(max_y);
+    }
+
+    void build_levels()
+    {
+        const int32_t lowest = std::numeric_limits<int32_t>::lowest();
+        const int32_t highest = std::numeric_limits<int32_t>::max();
+        size_t n = _x.size();
+
+        // Leaves.
+        _level_offsets.push_back(0);
+
+        for (size_t begin = 0; begin < n; begin += _node_capacity)
+        {
+            int32_t min_x = highest, min_y = highest, max_x = lowest, max_y = lowest;
+
+            for (size_t i = begin; i < std::min(n, begin + _node_capacity); i++)
+            {
+                min_x = std::min(min_x, _x[i]);
+                min_y = std::min(min_y, _y[i]);
+                max_x = std::max(max_x, _x[i]);
+                max_y = std::max(max_y, _y[i]);
+            }
+
+            add_node(min_x, min_y, max_x, max_y);
+        }
+
+        _level_offsets.push_back(_min_x.size());
+
+        // Inner levels, until a single root remains.
+        while (level_size(n_levels() - 1) > 1)
+        {
+            size_t child_begin = _level_offsets[n_levels() - 1];
+            size_t child_end = _level_offsets[n_levels()];
+
+            for (size_t begin = child_begin; begin < child_end; begin += _node_capacity)
+            {
+                int32_t min_x = highest, min_y = highest, max_x = lowest, max_y = lowest;
+
+                for (size_t c = begin; c < std::min(child_end, begin + _node_capacity); c++)
+                {
+                    min_x = std::min(min_x, _min_x[c]);
+                    min_y = std::min(min_y, _min_y[c]);
+                    max_x = std::max(max_x, _max_x[c]);
+                    max_y = std::max(max_y, _max_y[c]);
+                }
+
+                add_node(min_x, min_y, max_x, max_y);
+            }
+
+            _level_offsets.push_back(_min_x.size());
+        }
+    }
+
+    template <typename TNodeTest, typename TLeafVisit>
+    void search(size_t level, size_t node, TNodeTest &node_test, TLeafVisit &leaf_visit) const
+    {
+        if (level == 0)
+        {
+            size_t begin = node * _node_capacity;
+            leaf_visit(begin, std::min(_x.size(), begin + _node_capacity));
+            return;
+        }
+
+        size_t child_offset = _level_offsets[level - 1];
+        size_t child_begin = node * _node_capacity;
+        size_t child_end = std::min(level_size(level - 1), child_begin + _node_capacity);
+
+        for (size_t c = child_begin; c < child_end; c++)
+        {
+            size_t g = child_offset + c;
+
+            if (node_test(_min_x[g], _min_y[g], _max_x[g], _max_y[g]))
+            {
+                search(level - 1, c, node_test, leaf_visit);
+            }
+        }
+    }
+
+    template <typename TNodeTest, typename TLeafVisit>
+    void search(TNodeTest node_test, TLeafVisit leaf_visit) const
+    {
+        if (_x.empty())
+        {
+            return;
+        }
+
+        size_t root = _level_offsets[n_levels() - 1];
+
+        if (node_test(_min_x[root], _min_y[root], _max_x[root], _max_y[root]))
+        {
+            search(n_levels() - 1, 0, node_test, leaf_visit);
+        }
+    }
+
+    // Lower bound on the squared distance from (x, y) to the exact points of a quantized box. The box is widened by
+    // margin() to cover the quantization error.
+    inline double box_distance2(double x, double y, int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y) const
+    {
+        double dx = std::max(std::max(_quantizer.dequantize_x(min_x) - margin() - x, x - _quantizer.dequantize_x(max_x) - margin()), 0.0);
+        double dy = std::max(std::max(_quantizer.dequantize_y(min_y) - margin() - y, y - _quantizer.dequantize_y(max_y) - margin()), 0.0);
+        return dx * dx + dy * dy;
+    }
+
+    inline double margin() const
+    {
+        return _quantizer.max_error();
+    }
+
+    inline double exact_distance2(uint32_t id, double x, double y) const
+    {
+        double dx = _source.x(id) - x;
+        double dy = _source.y(id) - y;
+        return dx * dx + dy * dy;
+    }
+
+public:
+    QuantizedRTree(TSource source, const double *x, const double *y, size_t n, PackedRTree::SortOrder sort_order = PackedRTree::STR, size_t node_capacity = 16)
+        : _source(source), _quantizer(x, y, n), _node_capacity(std::max<size_t>(2, node_capacity))
+    {
+        std::vector<uint32_t> order;
+
+        if (n > 0)
+        {
+            order = sort_order == PackedRTree::HILBERT ? PackedRTree::sort_hilbert(x, y, n) : PackedRTree::sort_str(x, y, n, _node_capacity);
+        }
+
+        _x.reserve(n);
+        _y.reserve(n);
+        _ids.reserve(n);
+
+        for (auto i : order)
+        {
+            _x.push_back((int32_t)_quantizer.x(x[i]));
+            _y.push_back((int32_t)_quantizer.y(y[i]));
+            _ids.push_back(i);
+        }
+
+        build_levels();
+    }
+
+    inline size_t size() const
+    {
+        return _x.size();
+    }
+
+    inline size_t n_levels() const
+    {
+        return _level_offsets.size() - 1;
+    }
+
+    inline size_t level_size(size_t level) const
+    {
+        return _level_offsets[level + 1] - _level_offsets[level];
+    }
+
+    // Size of a quantization step, in the units of the coordinates.
+    inline double quantum() const
+    {
+        return _quantizer.scale();
+    }
+
+    size_t bytes() const
+    {
+        return sizeof(*this) +
+               (_x.capacity() + _y.capacity() + _min_x.capacity() + _min_y.capacity() + _max_x.capacity() + _max_y.capacity()) * sizeof(int32_t) +
+               _ids.capacity() * sizeof(uint32_t) +
+               _level_offsets.capacity() * sizeof(size_t);
+    }
+
+    // Call visit(id) for every point inside the (inclusive) box. A point strictly inside the quantized box is inside
+    // the box, a point outside it is outside; only points on its boundary are tested exactly.
+    template <typename TVisit>
+    void query_range(double min_x, double min_y, double max_x, double max_y, TVisit visit) const
+    {
+        int64_t q_min_x = _quantizer.x(min_x);
+        int64_t q_min_y = _quantizer.y(min_y);
+        int64_t q_max_x = _quantizer.x(max_x);
+        int64_t q_max_y = _quantizer.y(max_y);
+
+        search(
+            [=](int32_t n_min_x, int32_t n_min_y, int32_t n_max_x, int32_t n_max_y) {
+                return n_min_x <= q_max_x && n_max_x >= q_min_x && n_min_y <= q_max_y && n_max_y >= q_min_y;
+            },
+            [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    int64_t qx = _x[i];
+                    int64_t qy = _y[i];
+
+                    if (qx < q_min_x || qx > q_max_x || qy < q_min_y || qy > q_max_y)
+                    {
+                        continue;
+                    }
+
+                    if (qx > q_min_x && qx < q_max_x && qy > q_min_y && qy < q_max_y)
+                    {
+                        visit(_ids[i]);
+                        continue;
+                    }
+
+                    double x = _source.x(_ids[i]);
+                    double y = _source.y(_ids[i]);
+
+                    if (x >= min_x && x <= max_x && y >= min_y && y <= max_y)
+                    {
+                        visit(_ids[i]);
+                    }
+                }
+            });
+    }
+
+    // Call visit(id) for every point within the given distance of (x, y). Points whose dequantized position is more
+    // than margin() inside or outside the circle are decided without the source.
+    template <typename TVisit>
+    void query_distance(double x, double y, double distance, TVisit visit) const
+    {
+        double distance2 = distance * distance;
+        double inner2 = distance > margin() ? (distance - margin()) * (distance - margin()) : -1;
+        double outer2 = (distance + margin()) * (distance + margin());
+
+        search(
+            [&](int32_t n_min_x, int32_t n_min_y, int32_t n_max_x, int32_t n_max_y) {
+                return box_distance2(x, y, n_min_x, n_min_y, n_max_x, n_max_y) <= distance2;
+            },
+            [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    double dx = _quantizer.dequantize_x(_x[i]) - x;
+                    double dy = _quantizer.dequantize_y(_y[i]) - y;
+                    double d2 = dx * dx + dy * dy;
+
+                    if (d2 <= inner2 || (d2 <= outer2 && exact_distance2(_ids[i], x, y) <= distance2))
+                    {
+                        visit(_ids[i]);
+                    }
+                }
+            });
+    }
+
+    // Push the heap.k() points nearest to (x, y) into the heap with their exact squared distance. Best-first search
+    // as in PackedRTree, except that the points of an expanded leaf are queued on a lower bound of their distance and
+    // only read from the source once they reach the front of the queue while they can still enter the heap.
+    void query_knn(double x, double y, KnnHeap<uint32_t> &heap) const
+    {
+        if (_x.empty())
+        {
+            return;
+        }
+
+        // Points are queued on level POINT, with their position in leaf order as node.
+        const size_t POINT = std::numeric_limits<size_t>::max();
+
+        // Min-heap of (squared distance bound, level, node).
+        struct Entry
+        {
+            double distance2;
+            size_t level;
+            size_t node;
+
+            bool operator<(const Entry &other) const
+            {
+                return distance2 > other.distance2;
+            }
+        };
+
+        std::vector<Entry> queue;
+        size_t root = _level_offsets[n_levels() - 1];
+        queue.push_back({box_distance2(x, y, _min_x[root], _min_y[root], _max_x[root], _max_y[root]), n_levels() - 1, 0});
+
+        while (!queue.empty() && queue.front().distance2 < heap.bound())
+        {
+            auto entry = queue.front();
+            std::pop_heap(queue.begin(), queue.end());
+            queue.pop_back();
+
+            if (entry.level == POINT)
+            {
+                heap.push(exact_distance2(_ids[entry.node], x, y), _ids[entry.node]);
+                continue;
+            }
+
+            if (entry.level == 0)
+            {
+                size_t begin = entry.node * _node_capacity;
+
+                for (size_t i = begin; i < std::min(_x.size(), begin + _node_capacity); i++)
+                {
+                    double dx = _quantizer.dequantize_x(_x[i]) - x;
+                    double dy = _quantizer.dequantize_y(_y[i]) - y;
+                    double bound = std::max(0.0, std::sqrt(dx * dx + dy * dy) - margin());
+
+                    if (bound * bound < heap.bound())
+                    {
+                        queue.push_back({bound * bound, POINT, i});
+                        std::push_heap(queue.begin(), queue.end());
+                    }
+                }
+
+                continue;
+            }
+
+            size_t child_offset = _level_offsets[entry.level - 1];
+            size_t child_begin = entry.node * _node_capacity;
+            size_t child_end = std::min(level_size(entry.level - 1), child_begin + _node_capacity);
+
+            for (size_t c = child_begin; c < child_end; c++)
+            {
+                size_t g = child_offset + c;
+                double distance2 = box_distance2(x, y, _min_x[g], _min_y[g], _max_x[g], _max_y[g]);
+
+                if (distance2 < heap.bound())
+                {
+                    queue.push_back({distance2, entry.level - 1, c});
+                    std::push_heap(queue.begin(), queue.end());
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,189 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+#include "s2/s2point.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2cap.h"
+#include "../utils/knn.h"
+#include "../utils/flat_array.h"
+#include "../utils/snapshot.h"
+
+// Points sorted along the S2 space-filling curve (a Hilbert curve on each cube face), stored as a flat array of
+// leaf cell ids plus the original point ids: 12 bytes per point. A leaf cell is ~1 cm wide, so its center stands in
+// for the point itself. Regions are answered by decomposing them into a cell covering, where every covering cell
+// is a contiguous interval of the array that is found by binary search.
+class S2CellArray
+{
+public:
+    enum
+    {
+        SNAPSHOT_VERSION = 1,
+    };
+
+private:
+    FlatArray<uint64_t> _cells;
+    FlatArray<uint32_t> _ids;
+
+public:
+    S2CellArray(const std::vector<S2Point> &points)
+    {
+        std::vector<uint64_t> keys(points.size());
+
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            keys[i] = S2CellId(points[i]).id();
+        }
+
+        std::vector<uint32_t> order(points.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+        _cells.reserve(points.size());
+        _ids.reserve(points.size());
+
+        for (auto i : order)
+        {
+            _cells.push_back(keys[i]);
+            _ids.push_back(i);
+        }
+    }
+
+    // Maps the arrays of a snapshot written by save().
+    S2CellArray(SnapshotReader &reader) : _cells(reader.array<uint64_t>()), _ids(reader.array<uint32_t>()){};
+
+    static const char *snapshot_kind()
+    {
+        return "s2_cell_array";
+    }
+
+    void save(SnapshotWriter &writer) const
+    {
+        writer.array(_cells);
+        writer.array(_ids);
+    }
+
+    inline size_t size() const
+    {
+        return _cells.size();
+    }
+
+    size_t bytes() const
+    {
+        return sizeof(*this) + _cells.capacity() * sizeof(uint64_t) + _ids.capacity() * sizeof(uint32_t);
+    }
+
+    inline const uint64_t *cells() const
+    {
+        return _cells.data();
+    }
+
+    inline const uint32_t *ids() const
+    {
+        return _ids.data();
+    }
+
+    // Position of the first entry with a cell id >= key, searching [begin, size()).
+    inline size_t lower_bound(uint64_t key, size_t begin = 0) const
+    {
+        return std::lower_bound(_cells.begin() + begin, _cells.end(), key) - _cells.begin();
+    }
+
+    // Call visit(position, cell) for every entry inside one of the covering cells. The covering must be sorted and
+    // non-overlapping, as produced by S2RegionCoverer, so the intervals are found left to right. search(key, begin)
+    // must return the first position >= begin with a cell id >= key.
+    template <typename TVisit, typename TSearch>
+    void scan(const std::vector<S2CellId> &covering, TVisit visit, TSearch search) const
+    {
+        size_t position = 0;
+
+        for (const auto &cell : covering)
+        {
+            position = search(cell.range_min().id(), position);
+
+            uint64_t last = cell.range_max().id();
+
+            for (; position < _cells.size() && _cells[position] <= last; position++)
+            {
+                visit(position, cell);
+            }
+        }
+    }
+
+    // Call visit(id) for every point contained in the region. The coverer and covering buffer are passed in so that
+    // callers can reuse them between queries.
+    template <typename TRegion, typename TVisit, typename TSearch>
+    void query(const TRegion &region, S2RegionCoverer &coverer, std::vector<S2CellId> &covering, TVisit visit, TSearch search) const
+    {
+        covering.clear();
+        coverer.GetCovering(region, &covering);
+
+        // Points in covering cells that lie entirely inside the region need no refinement.
+        S2CellId current;
+        bool contained = false;
+
+        scan(
+            covering,
+            [&](size_t position, const S2CellId &cell) {
+                if (cell != current)
+                {
+                    current = cell;
+                    contained = region.Contains(S2Cell(cell));
+                }
+
+                if (contained || region.Contains(S2CellId(_cells[position]).ToPoint()))
+                {
+                    visit(_ids[position]);
+                }
+            },
+            search);
+    }
+
+    template <typename TRegion, typename TVisit>
+    void query(const TRegion &region, S2RegionCoverer &coverer, std::vector<S2CellId> &covering, TVisit visit) const
+    {
+        query(region, coverer, covering, visit, [this](uint64_t key, size_t begin) { return lower_bound(key, begin); });
+    }
+
+    // Push the heap.k() points nearest to the point into the heap with their squared chord distance. The k entries on
+    // either side of the point along the curve bound the distance of the k-th nearest point, so the exact neighbours
+    // are all inside the cap of that radius.
+    template <typename TSearch>
+    void query_knn(const S2Point &point, S2RegionCoverer &coverer, std::vector<S2CellId> &covering, KnnHeap<uint32_t> &heap, TSearch search) const
+    {
+        auto push = [&](size_t position) {
+            heap.push(S1ChordAngle(point, S2CellId(_cells[position]).ToPoint()).length2(), _ids[position]);
+        };
+
+        size_t position = search(S2CellId(point).id(), 0);
+        size_t begin = position > heap.k() ? position - heap.k() : 0;
+        size_t end = std::min(_cells.size(), position + heap.k());
+
+        for (size_t i = begin; i < end; i++)
+        {
+            push(i);
+        }
+
+        // With fewer than k points in the array, all of them were pushed.
+        if (!heap.full())
+        {
+            return;
+        }
+
+        S2Cap cap(point, S1ChordAngle::FromLength2(heap.bound()));
+        heap.clear();
+
+        covering.clear();
+        coverer.GetCovering(cap, &covering);
+        scan(covering, [&](size_t position, const S2CellId &cell) { push(position); }, search);
+    }
+
+    void query_knn(const S2Point &point, S2RegionCoverer &coverer, std::vector<S2CellId> &covering, KnnHeap<uint32_t> &heap) const
+    {
+        query_knn(point, coverer, covering, heap, [this](uint64_t key, size_t begin) { return lower_bound(key, begin); });
+    }
+};
@@ -0,0 +1,197 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "../utils/threadpool.h"
+
+// Assignment of point ids to shards: shard s holds ids[offsets[s]] .. ids[offsets[s + 1] - 1].
+struct ShardLayout
+{
+    std::vector<uint32_t> ids;
+    std::vector<size_t> offsets;
+
+    inline size_t n_shards() const
+    {
+        return offsets.size() - 1;
+    }
+};
+
+// Cut ids[begin, end) into n_shards shards starting at first_shard. Every cut is placed so that both sides get a
+// number of points proportional to their number of shards, across the wider side of the bounding box.
+void kd_split_range(const double *x, const double *y, uint32_t *ids, size_t begin, size_t end, size_t first_shard, size_t n_shards, std::vector<size_t> &offsets)
+{
+    if (n_shards == 1)
+    {
+        offsets[first_shard] = begin;
+        return;
+    }
+
+    double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        min_x = std::min(min_x, x[ids[i]]);
+        max_x = std::max(max_x, x[ids[i]]);
+        min_y = std::min(min_y, y[ids[i]]);
+        max_y = std::max(max_y, y[ids[i]]);
+    }
+
+    const double *axis = max_x - min_x >= max_y - min_y ? x : y;
+    size_t left_shards = n_shards / 2;
+    size_t cut = begin + (end - begin) * left_shards / n_shards;
+
+    std::nth_element(ids + begin, ids + cut, ids + end, [axis](uint32_t a, uint32_t b) { return axis[a] < axis[b]; });
+
+    // Both halves are independent, large ones are split on a thread of their own.
+    if (end - begin >= (1 << 20))
+    {
+        std::thread left([&]() { kd_split_range(x, y, ids, begin, cut, first_shard, left_shards, offsets); });
+        kd_split_range(x, y, ids, cut, end, first_shard + left_shards, n_shards - left_shards, offsets);
+        left.join();
+    }
+    else
+    {
+        kd_split_range(x, y, ids, begin, cut, first_shard, left_shards, offsets);
+        kd_split_range(x, y, ids, cut, end, first_shard + left_shards, n_shards - left_shards, offsets);
+    }
+}
+
+// k-d split of n points into n_shards shards of equal size, each a rectangle in the plane.
+ShardLayout kd_shard_layout(const double *x, const double *y, size_t n, size_t n_shards)
+{
+    n_shards = std::max<size_t>(1, std::min<size_t>(n_shards, n));
+
+    ShardLayout layout;
+    layout.ids.resize(n);
+    layout.offsets.resize(n_shards + 1);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        layout.ids[i] = i;
+    }
+
+    kd_split_range(x, y, layout.ids.data(), 0, n, 0, n_shards, layout.offsets);
+    layout.offsets[n_shards] = n;
+
+    return layout;
+}
+
+// Split of n points into n_shards runs of equal size along their sorted keys, e.g. S2 cell ids. Equal keys always
+// end up in the same shard, so shards hold disjoint key ranges but may differ somewhat in size.
+ShardLayout key_shard_layout(const uint64_t *keys, size_t n, size_t n_shards)
+{
+    n_shards = std::max<size_t>(1, std::min<size_t>(n_shards, n));
+
+    ShardLayout layout;
+    layout.ids.resize(n);
+    layout.offsets.resize(n_shards + 1);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        layout.ids[i] = i;
+    }
+
+    std::sort(layout.ids.begin(), layout.ids.end(), [keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+    layout.offsets[0] = 0;
+
+    for (size_t s = 1; s < n_shards; s++)
+    {
+        size_t cut = std::max(layout.offsets[s - 1], n * s / n_shards);
+
+        while (cut > layout.offsets[s - 1] && cut < n && keys[layout.ids[cut]] == keys[layout.ids[cut - 1]])
+        {
+            cut++;
+        }
+
+        layout.offsets[s] = cut;
+    }
+
+    layout.offsets[n_shards] = n;
+    return layout;
+}
+
+// One index per shard of the points, built concurrently. Every shard keeps bounds of type TBounds, which route a
+// query to the shards it overlaps; those are then searched in parallel on a thread pool shared by all shards, which
+// the index keeps alive.
+template <typename TShard, typename TBounds>
+class ShardedIndex
+{
+private:
+    std::vector<std::unique_ptr<TShard>> _shards;
+    std::vector<TBounds> _bounds;
+    std::vector<size_t> _sizes;
+    size_t _size;
+    std::shared_ptr<ThreadPool> _pool;
+
+public:
+    // build(ids, n, bounds) returns the index over the n points ids[0 .. n - 1] and sets the bounds of the shard.
+    // It is called for all shards concurrently on the pool.
+    template <typename TBuild>
+    ShardedIndex(const ShardLayout &layout, std::shared_ptr<ThreadPool> pool, TBuild build) : _size(layout.ids.size()), _pool(pool)
+    {
+        size_t n_shards = layout.n_shards();
+
+        _shards.resize(n_shards);
+        _bounds.resize(n_shards);
+        _sizes.resize(n_shards);
+
+        _pool->run(n_shards, [&](size_t s) {
+            _sizes[s] = layout.offsets[s + 1] - layout.offsets[s];
+            _shards[s] = build(layout.ids.data() + layout.offsets[s], _sizes[s], _bounds[s]);
+        });
+    }
+
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+    inline size_t n_shards() const
+    {
+        return _shards.size();
+    }
+
+    inline TShard &shard(size_t s) const
+    {
+        return *_shards[s];
+    }
+
+    inline const TBounds &bounds(size_t s) const
+    {
+        return _bounds[s];
+    }
+
+    inline size_t shard_size(size_t s) const
+    {
+        return _sizes[s];
+    }
+
+    size_t max_shard_size() const
+    {
+        return _sizes.empty() ? 0 : *std::max_element(_sizes.begin(), _sizes.end());
+    }
+
+    // Call visit(shard, s) for every shard s whose bounds satisfy overlaps(bounds). More than one matching shard
+    // is visited in parallel on the pool, so visit must only write to state of its own shard. Returns the number of
+    // shards visited.
+    template <typename TOverlaps, typename TVisit>
+    size_t fan_out(TOverlaps overlaps, TVisit visit) const
+    {
+        std::vector<uint32_t> targets;
+
+        for (size_t s = 0; s < _shards.size(); s++)
+        {
+            if (_sizes[s] > 0 && overlaps(_bounds[s]))
+            {
+                targets.push_back(s);
+            }
+        }
+
+        _pool->run(targets.size(), [&](size_t t) { visit(*_shards[targets[t]], (size_t)targets[t]); });
+        return targets.size();
+    }
+};
@@ -0,0 +1,201 @@
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// One [section] of a configuration file, with the keys of the unnamed leading section as defaults.
+class ConfigSection
+{
+private:
+    std::string _file_path;
+    std::string _name;
+    std::map<std::string, std::string> _values;
+
+    static std::string trim(const std::string &text)
+    {
+        auto begin = text.find_first_not_of(" \t\r");
+        auto end = text.find_last_not_of(" \t\r");
+        return begin == std::string::npos ? "" : text.substr(begin, end - begin + 1);
+    }
+
+    std::runtime_error error(std::string key, std::string message) const
+    {
+        return std::runtime_error("Key <" + key + "> of section [" + _name + "] in <" + _file_path + "> " + message + ".");
+    }
+
+public:
+    ConfigSection(std::string file_path, std::string name, std::map<std::string, std::string> values) : _file_path(file_path), _name(name), _values(values){};
+
+    inline const std::string &name() const
+    {
+        return _name;
+    }
+
+    bool has(std::string key) const
+    {
+        return _values.count(key) > 0;
+    }
+
+    // Throw if a key is set that is not in known, e.g. because of a typo.
+    void check_keys(const std::set<std::string> &known) const
+    {
+        for (const auto &value : _values)
+        {
+            if (known.count(value.first) == 0)
+            {
+                throw error(value.first, "is unknown");
+            }
+        }
+    }
+
+    std::string get(std::string key) const
+    {
+        if (!has(key))
+        {
+            throw error(key, "is missing");
+        }
+
+        return _values.at(key);
+    }
+
+    std::string get(std::string key, std::string fallback) const
+    {
+        return has(key) ? _values.at(key) : fallback;
+    }
+
+    // Comma-separated list, empty if the key is not set.
+    std::vector<std::string> list(std::string key) const
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(get(key, ""));
+        std::string item;
+
+        while (std::getline(stream, item, ','))
+        {
+            if (!trim(item).empty())
+            {
+                items.push_back(trim(item));
+            }
+        }
+
+        return items;
+    }
+
+    double number(std::string key, double fallback) const
+    {
+        if (!has(key))
+        {
+            return fallback;
+        }
+
+        try
+        {
+            return std::stod(get(key));
+        }
+        catch (const std::logic_error &)
+        {
+            throw error(key, "is not a number");
+        }
+    }
+
+    template <typename T>
+    std::vector<T> numbers(std::string key, std::vector<T> fallback) const
+    {
+        if (!has(key))
+        {
+            return fallback;
+        }
+
+        std::vector<T> values;
+
+        for (const auto &item : list(key))
+        {
+            try
+            {
+                values.push_back((T)std::stod(item));
+            }
+            catch (const std::logic_error &)
+            {
+                throw error(key, "holds <" + item + ">, which is not a number");
+            }
+        }
+
+        return values;
+    }
+
+    friend class ConfigFile;
+};
+
+// Configuration file of "key = value" lines, grouped into [sections]. Keys before the first section are defaults for
+// every section. Lines starting with # are comments.
+class ConfigFile
+{
+private:
+    std::vector<ConfigSection> _sections;
+
+public:
+    ConfigFile(std::string file_path)
+    {
+        std::ifstream file(file_path);
+
+        if (!file)
+        {
+            throw std::runtime_error("Could not open <" + file_path + ">.");
+        }
+
+        std::map<std::string, std::string> defaults;
+        std::map<std::string, std::string> *values = &defaults;
+        std::vector<std::pair<std::string, std::map<std::string, std::string>>> sections;
+
+        std::string line;
+        size_t line_number = 0;
+
+        while (std::getline(file, line))
+        {
+            line_number++;
+            line = ConfigSection::trim(line);
+
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            if (line.front() == '[' && line.back() == ']')
+            {
+                sections.push_back({ConfigSection::trim(line.substr(1, line.size() - 2)), {}});
+                values = &sections.back().second;
+                continue;
+            }
+
+            auto equals = line.find('=');
+
+            if (equals == std::string::npos)
+            {
+                throw std::runtime_error("Line " + std::to_string(line_number) + " of <" + file_path + "> is neither a section nor a key = value pair.");
+            }
+
+            (*values)[ConfigSection::trim(line.substr(0, equals))] = ConfigSection::trim(line.substr(equals + 1));
+        }
+
+        for (auto &section : sections)
+        {
+            auto merged = defaults;
+
+            for (const auto &value : section.second)
+            {
+                merged[value.first] = value.second;
+            }
+
+            _sections.emplace_back(file_path, section.first, merged);
+        }
+    }
+
+    inline const std::vector<ConfigSection> &sections() const
+    {
+        return _sections;
+    }
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Quote a CSV field if it contains a separator, quote or line break (RFC 4180).
+std::string csv_field(const std::string &value)
+{
+    if (value.find_first_of(",\"\r\n") == std::string::npos)
+    {
+        return value;
+    }
+
+    std::string quoted = "\"";
+
+    for (auto c : value)
+    {
+        quoted += c == '"' ? "\"\"" : std::string(1, c);
+    }
+
+    return quoted + "\"";
+}
+
+// Split one line of CSV into its fields, undoing the quoting of csv_field.
+std::vector<std::string> csv_split(const std::string &line)
+{
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+
+    for (size_t i = 0; i < line.size(); i++)
+    {
+        char c = line[i];
+
+        if (quoted && c == '"' && i + 1 < line.size() && line[i + 1] == '"')
+        {
+            fields.back() += '"';
+            i++;
+        }
+        else if (c == '"')
+        {
+            quoted = !quoted;
+        }
+        else if (c == ',' && !quoted)
+        {
+            fields.emplace_back();
+        }
+        else if (c != '\r' || quoted)
+        {
+            fields.back() += c;
+        }
+    }
+
+    return fields;
+}
@@ -3,6 +3,12 @@
 #include <fstream>
 #include <sstream>
 #include <tuple>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <cmath>
+#include "mmap.h"
 
 struct Coord
 {
@@ -22,23 +28,359 @@ struct RQuery
     Coord b;
 };
 
+// Query point of a k-nearest-neighbour query. k is chosen by the experiment, not stored in the file.
+struct KQuery
+{
+    Coord coord;
+};
+
+// View over a contiguous array of coordinates, e.g. (part of) a memory-mapped .bin file. The translation is
+// applied on access, so the underlying data is never copied or modified.
+class CoordinateSpan
+{
+private:
+    const Coord *_data;
+    size_t _size;
+    size_t _offset;
+    Coord _translation;
+
+public:
+    class ChunkIterator;
+    class Chunks;
+
+    CoordinateSpan(const Coord *data, size_t size, size_t offset = 0, const Coord &translation = {0, 0}) : _data(data), _size(size), _offset(offset), _translation(translation){};
+
+    inline Coord operator[](size_t i) const
+    {
+        return {_data[i].lat + _translation.lat, _data[i].lon + _translation.lon};
+    }
+
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+    // Position of the first coordinate within the originating file.
+    inline size_t offset() const
+    {
+        return _offset;
+    }
+
+    // Raw, untranslated coordinates.
+    inline const Coord *data() const
+    {
+        return _data;
+    }
+
+    inline const Coord &translation() const
+    {
+        return _translation;
+    }
+
+    CoordinateSpan subspan(size_t offset, size_t count) const
+    {
+        return CoordinateSpan(_data + offset, count, _offset + offset, _translation);
+    }
+
+    // Iterate over the span in consecutive sub-spans of at most chunk_size coordinates.
+    Chunks chunks(size_t chunk_size) const;
+};
+
+class CoordinateSpan::ChunkIterator
+{
+private:
+    const CoordinateSpan *_span;
+    size_t _position;
+    size_t _chunk_size;
+
+public:
+    ChunkIterator(const CoordinateSpan *span, size_t position, size_t chunk_size) : _span(span), _position(position), _chunk_size(chunk_size){};
+
+    CoordinateSpan operator*() const
+    {
+        return _span->subspan(_position, std::min(_chunk_size, _span->size() - _position));
+    }
+
+    ChunkIterator &operator++()
+    {
+        _position = std::min(_position + _chunk_size, _span->size());
+        return *this;
+    }
+
+    bool operator!=(const ChunkIterator &other) const
+    {
+        return _position != other._position;
+    }
+};
+
+class CoordinateSpan::Chunks
+{
+private:
+    CoordinateSpan _span;
+    size_t _chunk_size;
+
+public:
+    Chunks(const CoordinateSpan &span, size_t chunk_size) : _span(span), _chunk_size(chunk_size == 0 ? 1 : chunk_size){};
+
+    ChunkIterator begin() const
+    {
+        return ChunkIterator(&_span, 0, _chunk_size);
+    }
+
+    ChunkIterator end() const
+    {
+        return ChunkIterator(&_span, _span.size(), _chunk_size);
+    }
+};
+
+CoordinateSpan::Chunks CoordinateSpan::chunks(size_t chunk_size) const
+{
+    return Chunks(*this, chunk_size);
+}
+
+// Zero-copy access to a .bin coordinate file, which is a flat array of (lat, lon) doubles.
+class CoordinateFile
+{
+private:
+    MappedFile _file;
+    Coord _translation;
+
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+
+    CoordinateFile(std::string bin_file, const Coord &translation = {0, 0}) : _file(bin_file), _translation(translation)
+    {
+        static_assert(sizeof(Coord) == 2 * sizeof(double), "Coord must match the on-disk layout.");
+        _file.advise_sequential();
+    }
+
+    inline size_t size() const
+    {
+        return _file.size() / sizeof(Coord);
+    }
+
+    CoordinateSpan span() const
+    {
+        return CoordinateSpan(reinterpret_cast<const Coord *>(_file.data()), size(), 0, _translation);
+    }
+
+    CoordinateSpan::Chunks chunks(size_t chunk_size = DEFAULT_CHUNK_SIZE) const
+    {
+        return span().chunks(chunk_size);
+    }
+};
+
 std::vector<Coord> load_coordinates(std::string binFile, const Coord &translation = {0, 0})
 {
+    CoordinateFile file(binFile, translation);
+    auto span = file.span();
+
     std::vector<Coord> coordinates;
+    coordinates.reserve(span.size());
+
+    for (size_t i = 0; i < span.size(); i++)
+    {
+        coordinates.push_back(span[i]);
+    }
+
+    return coordinates;
+}
 
-    std::ifstream fin(binFile, std::ios::binary);
+// Binary query files start with this header, followed by `count` DQuery or RQuery records (native layout, so
+// they can be used straight from the mapping). Use tools/convert_queries.py to convert the CSV query files.
+struct QueryFileHeader
+{
+    char magic[4];      // "QRYB"
+    uint32_t version;   // QUERY_FILE_VERSION
+    uint32_t type;      // QueryType
+    uint32_t crs;       // EPSG code of the coordinates
+    uint64_t count;     // number of records
+    double selectivity; // fraction of points the queries were generated to return, NaN if unknown
+};
+
+enum QueryType : uint32_t
+{
+    DISTANCE_QUERY = 0,
+    RANGE_QUERY = 1,
+    KNN_QUERY = 2,
+};
 
-    double lat, lon;
+const char QUERY_FILE_MAGIC[4] = {'Q', 'R', 'Y', 'B'};
+// Version 2 stores the selectivity as a fraction instead of a percentage.
+const uint32_t QUERY_FILE_VERSION = 2;
+
+bool is_binary_query_file(std::string file_path)
+{
+    char magic[4];
+    std::ifstream fin(file_path, std::ios::binary);
+
+    return fin.read(magic, sizeof(magic)) && std::equal(magic, magic + 4, QUERY_FILE_MAGIC);
+}
+
+// A converted query file next to the CSV (same name, .qbin extension) is preferred over the CSV itself.
+std::string resolve_query_file(std::string file_path)
+{
+    const std::string csv = ".csv";
 
-    while (fin.read(reinterpret_cast<char *>(&lat), sizeof(double)) && fin.read(reinterpret_cast<char *>(&lon), sizeof(double)))
+    if (file_path.size() > csv.size() && file_path.compare(file_path.size() - csv.size(), csv.size(), csv) == 0)
     {
-        coordinates.push_back({lat + translation.lat, lon + translation.lon});
+        auto bin_path = file_path.substr(0, file_path.size() - csv.size()) + ".qbin";
+
+        if (std::ifstream(bin_path).good())
+        {
+            return bin_path;
+        }
     }
 
-    return coordinates;
+    return file_path;
 }
 
-std::vector<DQuery> _load_distance_queries(std::string queryFile, const Coord &translation = {0, 0})
+// Memory-mapped binary query file.
+class QueryFile
+{
+private:
+    MappedFile _file;
+
+public:
+    QueryFile(std::string file_path) : _file(file_path)
+    {
+        static_assert(sizeof(QueryFileHeader) == 32, "QueryFileHeader must match the on-disk layout.");
+        static_assert(sizeof(DQuery) == 3 * sizeof(double) && sizeof(RQuery) == 4 * sizeof(double) && sizeof(KQuery) == 2 * sizeof(double), "Query records must match the on-disk layout.");
+
+        if (_file.size() < sizeof(QueryFileHeader) || !std::equal(header().magic, header().magic + 4, QUERY_FILE_MAGIC))
+        {
+            throw std::runtime_error("<" + file_path + "> is not a binary query file.");
+        }
+
+        if (header().version != QUERY_FILE_VERSION)
+        {
+            throw std::runtime_error("<" + file_path + "> has unsupported version " + std::to_string(header().version) + ", convert it again with tools/convert_queries.py.");
+        }
+
+        if (_file.size() < sizeof(QueryFileHeader) + header().count * record_size())
+        {
+            throw std::runtime_error("<" + file_path + "> is truncated.");
+        }
+    }
+
+    inline const QueryFileHeader &header() const
+    {
+        return *reinterpret_cast<const QueryFileHeader *>(_file.data());
+    }
+
+    size_t record_size() const
+    {
+        switch (header().type)
+        {
+        case DISTANCE_QUERY:
+            return sizeof(DQuery);
+        case RANGE_QUERY:
+            return sizeof(RQuery);
+        case KNN_QUERY:
+            return sizeof(KQuery);
+        default:
+            throw std::runtime_error("Unknown query type " + std::to_string(header().type) + ".");
+        }
+    }
+
+    template <typename TQuery>
+    const TQuery *records(QueryType type) const
+    {
+        if (header().type != type)
+        {
+            throw std::runtime_error("Query file contains queries of type " + std::to_string(header().type) + ", expected " + std::to_string(type) + ".");
+        }
+
+        if (header().crs != 4326)
+        {
+            throw std::runtime_error("Query coordinates must be in EPSG:4326, got EPSG:" + std::to_string(header().crs) + ".");
+        }
+
+        return reinterpret_cast<const TQuery *>(_file.data() + sizeof(QueryFileHeader));
+    }
+};
+
+// Fraction of points the queries in the file were generated to return, or NaN if unknown. CSV files carry it in
+// their name as a percentage, e.g. taxi_range_0.1.csv.
+double query_file_selectivity(std::string file_path)
+{
+    file_path = resolve_query_file(file_path);
+
+    if (is_binary_query_file(file_path))
+    {
+        return QueryFile(file_path).header().selectivity;
+    }
+
+    auto name_end = file_path.rfind('.');
+    auto number_begin = file_path.rfind('_', name_end);
+
+    if (name_end == std::string::npos || number_begin == std::string::npos)
+    {
+        return NAN;
+    }
+
+    try
+    {
+        return std::stod(file_path.substr(number_begin + 1, name_end - number_begin - 1)) / 100;
+    }
+    catch (const std::logic_error &)
+    {
+        return NAN;
+    }
+}
+
+std::vector<DQuery> _load_distance_queries_bin(std::string queryFile, const Coord &translation)
+{
+    QueryFile file(queryFile);
+    auto records = file.records<DQuery>(DISTANCE_QUERY);
+
+    std::vector<DQuery> queries;
+    queries.reserve(file.header().count);
+
+    for (size_t i = 0; i < file.header().count; i++)
+    {
+        auto q = records[i];
+        queries.push_back({{q.coord.lat + translation.lat, q.coord.lon + translation.lon}, q.distance});
+    }
+
+    return queries;
+}
+
+std::vector<RQuery> _load_range_queries_bin(std::string queryFile, const Coord &translation)
+{
+    QueryFile file(queryFile);
+    auto records = file.records<RQuery>(RANGE_QUERY);
+
+    std::vector<RQuery> queries;
+    queries.reserve(file.header().count);
+
+    for (size_t i = 0; i < file.header().count; i++)
+    {
+        auto q = records[i];
+        queries.push_back({{q.a.lat + translation.lat, q.a.lon + translation.lon}, {q.b.lat + translation.lat, q.b.lon + translation.lon}});
+    }
+
+    return queries;
+}
+
+// Distance query files are accepted as well, their query points are used.
+std::vector<KQuery> _load_knn_queries_bin(std::string queryFile, const Coord &translation)
+{
+    QueryFile file(queryFile);
+
+    std::vector<KQuery> queries;
+    queries.reserve(file.header().count);
+
+    for (size_t i = 0; i < file.header().count; i++)
+    {
+        auto coord = file.header().type == DISTANCE_QUERY ? file.records<DQuery>(DISTANCE_QUERY)[i].coord : file.records<KQuery>(KNN_QUERY)[i].coord;
+        queries.push_back({{coord.lat + translation.lat, coord.lon + translation.lon}});
+    }
+
+    return queries;
+}
+
+std::vector<DQuery> _load_distance_queries_csv(std::string queryFile, const Coord &translation)
 {
     std::vector<DQuery> queries;
     std::ifstream fin(queryFile);
@@ -63,7 +405,7 @@ std::vector<DQuery> _load_distance_queries(std::string queryFile, const Coord &t
     return queries;
 }
 
-std::vector<RQuery> _load_range_queries(std::string queryFile, const Coord &translation = {0, 0})
+std::vector<RQuery> _load_range_queries_csv(std::string queryFile, const Coord &translation)
 {
     std::vector<RQuery> queries;
     std::ifstream fin(queryFile);
@@ -88,4 +430,67 @@ std::vector<RQuery> _load_range_queries(std::string queryFile, const Coord &tran
     }
 
     return queries;
+}
+
+// Only the first two columns are read, so distance query files can be used as well.
+std::vector<KQuery> _load_knn_queries_csv(std::string queryFile, const Coord &translation)
+{
+    std::vector<KQuery> queries;
+    std::ifstream fin(queryFile);
+
+    std::string line;
+
+    while (std::getline(fin, line))
+    {
+        std::string value;
+        std::stringstream ss(line);
+
+        std::getline(ss, value, ',');
+        double lat = std::stod(value);
+        std::getline(ss, value, ',');
+        double lon = std::stod(value);
+
+        queries.push_back({{lat + translation.lat, lon + translation.lon}});
+    }
+
+    return queries;
+}
+
+// Load distance queries from either a CSV (lat,lon,distance per line) or a binary query file.
+std::vector<DQuery> _load_distance_queries(std::string queryFile, const Coord &translation = {0, 0})
+{
+    queryFile = resolve_query_file(queryFile);
+
+    if (is_binary_query_file(queryFile))
+    {
+        return _load_distance_queries_bin(queryFile, translation);
+    }
+
+    return _load_distance_queries_csv(queryFile, translation);
+}
+
+// Load range queries from either a CSV (lat_a,lon_a,lat_b,lon_b per line) or a binary query file.
+std::vector<RQuery> _load_range_queries(std::string queryFile, const Coord &translation = {0, 0})
+{
+    queryFile = resolve_query_file(queryFile);
+
+    if (is_binary_query_file(queryFile))
+    {
+        return _load_range_queries_bin(queryFile, translation);
+    }
+
+    return _load_range_queries_csv(queryFile, translation);
+}
+
+// Load kNN query points from either a CSV (lat,lon per line) or a binary query file.
+std::vector<KQuery> _load_knn_queries(std::string queryFile, const Coord &translation = {0, 0})
+{
+    queryFile = resolve_query_file(queryFile);
+
+    if (is_binary_query_file(queryFile))
+    {
+        return _load_knn_queries_bin(queryFile, translation);
+    }
+
+    return _load_knn_queries_csv(queryFile, translation);
 }
\ No newline at end of file
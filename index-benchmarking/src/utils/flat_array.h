@@ -0,0 +1,161 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+// Contiguous array of trivially copyable elements that either owns them, like std::vector, or views elements that
+// live in memory owned elsewhere, such as a mapped snapshot file. A view keeps its owner alive and is read-only: the
+// modifying members (reserve, push_back, resize, assign, clear) may only be used on owned arrays.
+template <typename T>
+class FlatArray
+{
+    static_assert(std::is_trivially_copyable<T>::value, "FlatArray elements are stored and mapped as raw bytes.");
+
+private:
+    std::vector<T> _owned;
+    std::shared_ptr<const void> _owner; // set for views only
+    T *_data;
+    size_t _size;
+
+    inline void sync()
+    {
+        _data = _owned.data();
+        _size = _owned.size();
+    }
+
+public:
+    FlatArray() : _data(nullptr), _size(0){};
+    explicit FlatArray(size_t n, const T &value = T()) : _owned(n, value) { sync(); }
+    FlatArray(const T *first, const T *last) : _owned(first, last) { sync(); }
+    FlatArray(std::vector<T> &&owned) : _owned(std::move(owned)) { sync(); }
+
+    // View of n elements at data, valid for as long as owner lives.
+    FlatArray(const T *data, size_t n, std::shared_ptr<const void> owner) : _owner(std::move(owner)), _data(const_cast<T *>(data)), _size(n){};
+
+    FlatArray(const FlatArray &other) : _owned(other._owned), _owner(other._owner), _data(other._data), _size(other._size)
+    {
+        if (!_owner)
+        {
+            sync();
+        }
+    }
+
+    // Moving a vector keeps its buffer, so the data pointer stays valid.
+    FlatArray(FlatArray &&other) : _owned(std::move(other._owned)), _owner(std::move(other._owner)), _data(other._data), _size(other._size)
+    {
+        other._owned.clear();
+        other._data = nullptr;
+        other._size = 0;
+    }
+
+    FlatArray &operator=(FlatArray other)
+    {
+        std::swap(_owned, other._owned);
+        std::swap(_owner, other._owner);
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        return *this;
+    }
+
+    inline bool is_view() const
+    {
+        return _owner != nullptr;
+    }
+
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+    inline bool empty() const
+    {
+        return _size == 0;
+    }
+
+    // Elements the array holds memory for: the allocation for owned arrays, the viewed elements for views.
+    inline size_t capacity() const
+    {
+        return is_view() ? _size : _owned.capacity();
+    }
+
+    inline T *data()
+    {
+        return _data;
+    }
+
+    inline const T *data() const
+    {
+        return _data;
+    }
+
+    inline T &operator[](size_t i)
+    {
+        return _data[i];
+    }
+
+    inline const T &operator[](size_t i) const
+    {
+        return _data[i];
+    }
+
+    inline T *begin()
+    {
+        return _data;
+    }
+
+    inline const T *begin() const
+    {
+        return _data;
+    }
+
+    inline T *end()
+    {
+        return _data + _size;
+    }
+
+    inline const T *end() const
+    {
+        return _data + _size;
+    }
+
+    inline T &back()
+    {
+        return _data[_size - 1];
+    }
+
+    inline const T &back() const
+    {
+        return _data[_size - 1];
+    }
+
+    void reserve(size_t n)
+    {
+        _owned.reserve(n);
+        sync();
+    }
+
+    void push_back(const T &value)
+    {
+        _owned.push_back(value);
+        sync();
+    }
+
+    void resize(size_t n)
+    {
+        _owned.resize(n);
+        sync();
+    }
+
+    void assign(size_t n, const T &value)
+    {
+        _owned.assign(n, value);
+        sync();
+    }
+
+    void clear()
+    {
+        _owned.clear();
+        sync();
+    }
+};
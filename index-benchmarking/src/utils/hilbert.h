@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+
+// Position of cell (x, y) along the Hilbert curve that fills a 2^order x 2^order grid.
+uint64_t hilbert_index(uint32_t x, uint32_t y, int order = 16)
+{
+    uint64_t d = 0;
+    uint32_t n = order >= 32 ? 0 : 1u << order; // only used as n - 1, which wraps to the full mask for order 32
+
+    for (uint32_t s = 1u << (order - 1); s > 0; s >>= 1)
+    {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += (uint64_t)s * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant so the curve continues in the right orientation.
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+
+            std::swap(x, y);
+        }
+    }
+
+    return d;
+}
+
+// Maps planar coordinates within a bounding box onto the Hilbert curve.
+class HilbertMapper
+{
+private:
+    double _min_x;
+    double _min_y;
+    double _scale_x;
+    double _scale_y;
+    int _order;
+
+public:
+    HilbertMapper(double min_x, double min_y, double max_x, double max_y, int order = 16) : _min_x(min_x), _min_y(min_y), _order(order)
+    {
+        double cells = (double)((1ull << order) - 1);
+        _scale_x = max_x > min_x ? cells / (max_x - min_x) : 0;
+        _scale_y = max_y > min_y ? cells / (max_y - min_y) : 0;
+    }
+
+    inline uint64_t operator()(double x, double y) const
+    {
+        double cells = (double)((1ull << _order) - 1);
+        double gx = std::min(std::max((x - _min_x) * _scale_x, 0.0), cells);
+        double gy = std::min(std::max((y - _min_y) * _scale_y, 0.0), cells);
+
+        return hilbert_index((uint32_t)gx, (uint32_t)gy, _order);
+    }
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+// Log-bucketed latency histogram in the style of HdrHistogram. Values are nanoseconds. Every power of two is
+// split into 2^SUB_BUCKET_BITS linear sub-buckets, so any recorded value is reported within ~3% of its true
+// value while the histogram stays a fixed-size array. Recording is a handful of integer operations.
+class LatencyHistogram
+{
+private:
+    static const int SUB_BUCKET_BITS = 5;
+    static const uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const size_t N_BUCKETS = (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+    std::array<uint64_t, N_BUCKETS> _counts;
+    uint64_t _total;
+    uint64_t _sum;
+    uint64_t _min;
+    uint64_t _max;
+
+    static inline size_t bucket_index(uint64_t value)
+    {
+        // Values below 2 * SUB_BUCKETS are stored exactly.
+        if (value < 2 * SUB_BUCKETS)
+        {
+            return value;
+        }
+
+        int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + (value >> shift) - SUB_BUCKETS;
+    }
+
+    // Highest value that maps to the given bucket.
+    static inline uint64_t bucket_upper(size_t index)
+    {
+        if (index < 2 * SUB_BUCKETS)
+        {
+            return index;
+        }
+
+        int shift = index / SUB_BUCKETS - 1;
+        uint64_t mantissa = index % SUB_BUCKETS + SUB_BUCKETS;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+public:
+    LatencyHistogram() : _total(0), _sum(0), _min(UINT64_MAX), _max(0)
+    {
+        _counts.fill(0);
+    }
+
+    inline void record(uint64_t nanoseconds)
+    {
+        _counts[bucket_index(nanoseconds)]++;
+        _total++;
+        _sum += nanoseconds;
+        _min = std::min(_min, nanoseconds);
+        _max = std::max(_max, nanoseconds);
+    }
+
+    template <typename TDuration>
+    inline void record(TDuration duration)
+    {
+        record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (size_t i = 0; i < N_BUCKETS; i++)
+        {
+            _counts[i] += other._counts[i];
+        }
+
+        _total += other._total;
+        _sum += other._sum;
+        _min = std::min(_min, other._min);
+        _max = std::max(_max, other._max);
+    }
+
+    inline uint64_t count() const
+    {
+        return _total;
+    }
+
+    inline uint64_t max() const
+    {
+        return _max;
+    }
+
+    inline uint64_t min() const
+    {
+        return _total == 0 ? 0 : _min;
+    }
+
+    inline double mean() const
+    {
+        return _total == 0 ? 0 : (double)_sum / _total;
+    }
+
+    // Smallest bucket bound below which at least the given fraction (0..1) of the recorded values lies.
+    uint64_t percentile(double fraction) const
+    {
+        if (_total == 0)
+        {
+            return 0;
+        }
+
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)(fraction * _total + 0.5));
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < N_BUCKETS; i++)
+        {
+            seen += _counts[i];
+
+            if (seen >= rank)
+            {
+                return std::min(bucket_upper(i), _max);
+            }
+        }
+
+        return _max;
+    }
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <fstream>
+#include "git_commit.h"
+
+// Commit the executable was built from ("git describe --always --dirty"), generated by CMake on every build.
+std::string build_commit()
+{
+    return GIT_COMMIT;
+}
+
+// CPU model name from /proc/cpuinfo, or "unknown" if it cannot be read.
+std::string host_cpu()
+{
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+
+    while (std::getline(cpuinfo, line))
+    {
+        auto colon = line.find(':');
+
+        if (line.compare(0, 10, "model name") == 0 && colon != std::string::npos)
+        {
+            auto begin = line.find_first_not_of(" \t", colon + 1);
+            return begin == std::string::npos ? "unknown" : line.substr(begin);
+        }
+    }
+
+    return "unknown";
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+// Keeps the k smallest (distance, id) pairs pushed so far in a bounded max-heap. Distances only need to be
+// comparable, e.g. squared distances. The heap is owned by the caller so that it can be reused between queries.
+template <typename TId>
+class KnnHeap
+{
+private:
+    size_t _k;
+    std::vector<std::pair<double, TId>> _heap;
+
+public:
+    KnnHeap(size_t k) : _k(std::max<size_t>(1, k))
+    {
+        _heap.reserve(_k);
+    }
+
+    inline size_t k() const
+    {
+        return _k;
+    }
+
+    inline size_t size() const
+    {
+        return _heap.size();
+    }
+
+    inline bool full() const
+    {
+        return _heap.size() == _k;
+    }
+
+    inline void clear()
+    {
+        _heap.clear();
+    }
+
+    // Distance a candidate must beat to be kept, infinite until k pairs were pushed.
+    inline double bound() const
+    {
+        return full() ? _heap.front().first : std::numeric_limits<double>::infinity();
+    }
+
+    inline void push(double distance, TId id)
+    {
+        if (!full())
+        {
+            _heap.emplace_back(distance, id);
+            std::push_heap(_heap.begin(), _heap.end());
+        }
+        else if (distance < _heap.front().first)
+        {
+            std::pop_heap(_heap.begin(), _heap.end());
+            _heap.back() = {distance, id};
+            std::push_heap(_heap.begin(), _heap.end());
+        }
+    }
+
+    // The kept pairs by increasing distance. Call clear() before pushing again.
+    const std::vector<std::pair<double, TId>> &sorted()
+    {
+        std::sort_heap(_heap.begin(), _heap.end());
+        return _heap;
+    }
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <gperftools/malloc_extension.h>
+
+// Bytes currently handed out by tcmalloc to the application (excludes allocator overhead and free lists).
+size_t allocated_bytes()
+{
+    size_t value = 0;
+    MallocExtension::instance()->GetNumericProperty("generic.current_allocated_bytes", &value);
+    return value;
+}
+
+// Read a "<field>: <n> kB" line from /proc/self/status. Returns 0 if it cannot be read.
+size_t _proc_status_bytes(std::string field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, field.size() + 1, field + ":") == 0)
+        {
+            std::stringstream ss(line.substr(field.size() + 1));
+            size_t kilobytes = 0;
+            ss >> kilobytes;
+            return kilobytes * 1024;
+        }
+    }
+
+    return 0;
+}
+
+size_t current_rss_bytes()
+{
+    return _proc_status_bytes("VmRSS");
+}
+
+// Peak resident set size since process start, or since the last reset_peak_rss().
+size_t peak_rss_bytes()
+{
+    return _proc_status_bytes("VmHWM");
+}
+
+// Reset the peak RSS to the current RSS, so the next phase can be measured on its own. Best-effort: on kernels
+// without support the peak keeps covering the whole process.
+void reset_peak_rss()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+}
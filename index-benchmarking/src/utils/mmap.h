@@ -0,0 +1,103 @@
+#pragma once
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Read-only memory mapping of a complete file. The mapping is released when the object goes out of scope.
+class MappedFile
+{
+private:
+    void *_data;
+    size_t _size;
+
+public:
+    MappedFile(std::string file_path) : _data(nullptr), _size(0)
+    {
+        int fd = open(file_path.c_str(), O_RDONLY);
+
+        if (fd < 0)
+        {
+            throw std::runtime_error("Could not open <" + file_path + ">.");
+        }
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("Could not stat <" + file_path + ">.");
+        }
+
+        _size = st.st_size;
+
+        if (_size > 0)
+        {
+            _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (_data == MAP_FAILED)
+            {
+                _data = nullptr;
+                close(fd);
+                throw std::runtime_error("Could not map <" + file_path + ">.");
+            }
+        }
+
+        // The mapping stays valid after the descriptor is closed.
+        close(fd);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) : _data(other._data), _size(other._size)
+    {
+        other._data = nullptr;
+        other._size = 0;
+    }
+
+    ~MappedFile()
+    {
+        if (_data != nullptr)
+        {
+            munmap(_data, _size);
+        }
+    }
+
+    inline const char *data() const
+    {
+        return static_cast<const char *>(_data);
+    }
+
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+    // Hint the kernel that the file is read front to back, so it reads ahead aggressively.
+    void advise_sequential() const
+    {
+        if (_data != nullptr)
+        {
+            madvise(_data, _size, MADV_SEQUENTIAL);
+        }
+    }
+};
+
+// Drop the cached pages of a file, so that the next mapping of it reads from disk as after a restart. Only clean
+// pages can be dropped, so the file is synced first. Best effort: failures are ignored.
+void evict_page_cache(std::string file_path)
+{
+    int fd = open(file_path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        return;
+    }
+
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
\ No newline at end of file
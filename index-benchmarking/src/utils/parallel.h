@@ -0,0 +1,66 @@
+#pragma once
+#include <thread>
+#include <vector>
+#include <exception>
+#include <algorithm>
+
+unsigned int hardware_threads()
+{
+    auto n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// Split [0, n) into contiguous blocks and call fn(begin, end, thread_id) for every block on its own thread.
+// Blocks are never smaller than min_block, so small inputs do not pay for idle threads. Exceptions thrown by a
+// worker are rethrown on the calling thread.
+template <typename F>
+void parallel_for(size_t n, unsigned int n_threads, F fn, size_t min_block = 1)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    size_t max_threads = (n + min_block - 1) / std::max<size_t>(min_block, 1);
+    n_threads = std::max<size_t>(1, std::min<size_t>(n_threads, max_threads));
+
+    if (n_threads == 1)
+    {
+        fn(0, n, 0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(n_threads);
+    size_t block = (n + n_threads - 1) / n_threads;
+
+    for (unsigned int t = 0; t < n_threads; t++)
+    {
+        size_t begin = std::min(n, t * block);
+        size_t end = std::min(n, begin + block);
+
+        threads.emplace_back([&fn, &errors, begin, end, t]() {
+            try
+            {
+                fn(begin, end, t);
+            }
+            catch (...)
+            {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    for (const auto &error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// Hardware counters of this process through perf_event_open, counting user space only. Counters are inherited by
+// threads created while they are open, and values() includes the counts of those threads, whether they are still
+// running or have exited. Threads that already existed when the counters were opened are not counted.
+//
+// Every event is opened on its own rather than as one group, because the kernel cannot read inherited groups. The
+// kernel may therefore multiplex them, which values() corrects for by scaling with the time each event was counted.
+// Events that cannot be opened (perf_event_paranoid, containers, virtual machines without a PMU) are left out.
+class PerfCounters
+{
+private:
+    struct Event
+    {
+        std::string name;
+        uint32_t type;
+        uint64_t config;
+    };
+
+    std::vector<std::string> _names;
+    std::vector<int> _fds;
+
+    static uint64_t cache_miss(uint64_t cache)
+    {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    static const std::vector<Event> &events()
+    {
+        static const std::vector<Event> events = {
+            {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {"l1d_misses", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D)},
+            {"llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {"dtlb_misses", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+            {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+
+        return events;
+    }
+
+    // Warn once per process, so a restricted machine does not flood every phase with the same message.
+    static void warn_unavailable(int error)
+    {
+        static bool warned = false;
+
+        if (!warned)
+        {
+            std::cerr << "Hardware counters unavailable (" << std::strerror(error) << "), check /proc/sys/kernel/perf_event_paranoid." << std::endl;
+            warned = true;
+        }
+    }
+
+public:
+    // Open the counters disabled; they only count between start() and stop().
+    PerfCounters()
+    {
+        int error = 0;
+
+        for (const auto &event : events())
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = event.type;
+            attr.config = event.config;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+
+            if (fd < 0)
+            {
+                error = errno;
+                continue;
+            }
+
+            _names.push_back(event.name);
+            _fds.push_back(fd);
+        }
+
+        if (_fds.empty())
+        {
+            warn_unavailable(error);
+        }
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    ~PerfCounters()
+    {
+        for (auto fd : _fds)
+        {
+            close(fd);
+        }
+    }
+
+    inline bool available() const
+    {
+        return !_fds.empty();
+    }
+
+    // Names of the events that could be opened, in the order of values().
+    inline const std::vector<std::string> &names() const
+    {
+        return _names;
+    }
+
+    // Start or resume counting; counts of consecutive start() .. stop() intervals add up.
+    void start()
+    {
+        for (auto fd : _fds)
+        {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void stop()
+    {
+        for (auto fd : _fds)
+        {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    // Counts so far, each divided by per (e.g. the number of points or queries) and scaled up for multiplexing.
+    std::vector<double> values(double per = 1) const
+    {
+        std::vector<double> values;
+
+        for (auto fd : _fds)
+        {
+            uint64_t data[3] = {0, 0, 0};
+            double value = 0;
+
+            if (read(fd, data, sizeof(data)) == sizeof(data) && data[2] > 0)
+            {
+                value = (double)data[0] * data[1] / data[2];
+            }
+
+            values.push_back(per > 0 ? value / per : 0);
+        }
+
+        return values;
+    }
+};
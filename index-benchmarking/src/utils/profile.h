@@ -0,0 +1,137 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <unordered_map>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <gperftools/profiler.h>
+
+// Sampling CPU profile of one benchmark phase through the gperftools profiler. The profile is written in the pprof
+// format to file, and as collapsed stacks ("main;build_index;insert 42" per line) to file + ".collapsed", ready for
+// flamegraph.pl. Stacks are symbolized in-process with dladdr, so functions of the executable itself only get a name
+// if it is linked with -rdynamic; others show up as the module they were found in.
+class CpuProfile
+{
+private:
+    std::string _file;
+    bool _running = false;
+
+    static std::string symbol(uintptr_t pc)
+    {
+        Dl_info info;
+
+        if (dladdr((void *)pc, &info) == 0)
+        {
+            std::stringstream ss;
+            ss << "0x" << std::hex << pc;
+            return ss.str();
+        }
+
+        if (info.dli_sname == nullptr)
+        {
+            std::string module = info.dli_fname == nullptr ? "?" : info.dli_fname;
+            return "[" + module.substr(module.find_last_of('/') + 1) + "]";
+        }
+
+        int status = 0;
+        char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 ? demangled : info.dli_sname;
+        free(demangled);
+
+        return name;
+    }
+
+    // The profile is a sequence of machine words: a header (0, 3, 0, period, 0), then per stack its sample count,
+    // depth and program counters (innermost first), and a trailer (0, 1, 0).
+    void write_collapsed() const
+    {
+        std::ifstream in(_file, std::ios::binary);
+        std::vector<uintptr_t> words;
+        uintptr_t word;
+
+        while (in.read((char *)&word, sizeof(word)))
+        {
+            words.push_back(word);
+        }
+
+        std::map<std::string, size_t> stacks;
+        std::unordered_map<uintptr_t, std::string> symbols;
+
+        for (size_t i = 5; i + 2 <= words.size();)
+        {
+            uintptr_t count = words[i];
+            uintptr_t depth = words[i + 1];
+
+            if (count == 0 || i + 2 + depth > words.size())
+            {
+                break;
+            }
+
+            // Return addresses point after the call, so step back into it before symbolizing.
+            std::string stack;
+
+            for (size_t frame = depth; frame-- > 0;)
+            {
+                uintptr_t pc = words[i + 2 + frame] - (frame == 0 ? 0 : 1);
+
+                if (symbols.count(pc) == 0)
+                {
+                    symbols[pc] = symbol(pc);
+                }
+
+                stack += (stack.empty() ? "" : ";") + symbols[pc];
+            }
+
+            stacks[stack] += count;
+            i += 2 + depth;
+        }
+
+        std::ofstream out(_file + ".collapsed");
+
+        for (const auto &stack : stacks)
+        {
+            out << stack.first << " " << stack.second << std::endl;
+        }
+    }
+
+public:
+    // Start profiling into file; an empty file disables the profile.
+    CpuProfile(std::string file) : _file(file)
+    {
+        if (_file.empty())
+        {
+            return;
+        }
+
+        _running = ProfilerStart(_file.c_str()) != 0;
+
+        if (!_running)
+        {
+            std::cerr << "Could not start CPU profile <" << _file << ">." << std::endl;
+        }
+    }
+
+    CpuProfile(const CpuProfile &) = delete;
+    CpuProfile &operator=(const CpuProfile &) = delete;
+
+    ~CpuProfile()
+    {
+        stop();
+    }
+
+    void stop()
+    {
+        if (!_running)
+        {
+            return;
+        }
+
+        ProfilerStop();
+        _running = false;
+        write_collapsed();
+    }
+};
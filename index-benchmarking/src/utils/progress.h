@@ -6,6 +6,56 @@
 #include <iostream>
 #include <iomanip>
 
+// Progress of one thread through a hot loop, such as a query executor. Calls only increment a counter of the thread
+// itself, which is added to the shared progress every PUBLISH_INTERVAL calls and when the counter is destroyed, so
+// threads do not contend on the shared cache line. Counters without shared progress count nothing.
+class ProgressCounter
+{
+private:
+    enum
+    {
+        PUBLISH_INTERVAL = 1024,
+    };
+
+    std::atomic<size_t> *_shared;
+    size_t _local = 0;
+
+public:
+    ProgressCounter(std::atomic<size_t> *shared = nullptr) : _shared(shared){};
+
+    ProgressCounter(const ProgressCounter &) = delete;
+    ProgressCounter &operator=(const ProgressCounter &) = delete;
+
+    ProgressCounter(ProgressCounter &&other) : _shared(other._shared), _local(other._local)
+    {
+        other._local = 0;
+    }
+
+    ~ProgressCounter()
+    {
+        publish();
+    }
+
+    // Called once per item, with the same arguments as a progress callback; only the number of calls counts.
+    inline void operator()(size_t i, size_t n)
+    {
+        if (++_local == PUBLISH_INTERVAL)
+        {
+            publish();
+        }
+    }
+
+    void publish()
+    {
+        if (_shared != nullptr && _local > 0)
+        {
+            _shared->fetch_add(_local, std::memory_order_relaxed);
+        }
+
+        _local = 0;
+    }
+};
+
 class ProgressTracker
 {
 private:
@@ -13,8 +63,8 @@ private:
     std::chrono::_V2::system_clock::time_point start_time;
     std::chrono::_V2::system_clock::time_point end_time;
     std::atomic<bool> running;
-    std::atomic<int> total;
-    std::atomic<int> progress;
+    std::atomic<size_t> total;
+    std::atomic<size_t> progress;
 
     static std::string get_timer_string(int seconds)
     {
@@ -87,6 +137,13 @@ public:
         total.store(n);
     }
 
+    // Counter for one thread of a parallel loop over n items in total. Every thread needs its own.
+    ProgressCounter counter(size_t n)
+    {
+        total.store(n);
+        return ProgressCounter(&progress);
+    }
+
     auto bind()
     {
         return std::bind(&ProgressTracker::set, this, std::placeholders::_1, std::placeholders::_2);
@@ -109,6 +166,11 @@ public:
         return get_timer_string(seconds_passed);
     }
 
+    inline double get_seconds()
+    {
+        return std::chrono::duration<double>(end_time - start_time).count();
+    }
+
     inline float get_throughput()
     {
         auto milliseconds_passed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
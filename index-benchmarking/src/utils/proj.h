@@ -1,6 +1,13 @@
 #pragma once
 #include <proj.h>
 #include <tuple>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include "data.h"
+#include "parallel.h"
 
 class ProjWrapper
 {
@@ -26,3 +33,73 @@ public:
         return std::tuple<double, double>(b.xy.x, b.xy.y);
     }
 };
+
+// Projects large amounts of coordinates on all cores. A PJ object (and its context) must not be shared between
+// threads, so every worker creates its own and converts its block in batches through proj_trans_generic.
+class ParallelProjector
+{
+private:
+    std::string _crs_from;
+    std::string _crs_to;
+    unsigned int _n_threads;
+    size_t _batch_size;
+
+public:
+    ParallelProjector(std::string crsFrom, std::string crsTo, unsigned int n_threads = hardware_threads(), size_t batch_size = 1 << 14)
+        : _crs_from(crsFrom), _crs_to(crsTo), _n_threads(n_threads), _batch_size(batch_size){};
+
+    // Project coordinates source(0) .. source(n - 1) and hand every result to sink(i, x, y, thread_id). Both are
+    // called concurrently from the worker threads, so the sink should write to preallocated storage.
+    template <typename TSource, typename TSink>
+    void transform(size_t n, TSource source, TSink sink, std::function<void(size_t, size_t)> progress = [](size_t, size_t) {}) const
+    {
+        std::atomic<size_t> done(0);
+
+        parallel_for(n, _n_threads, [&](size_t begin, size_t end, unsigned int thread_id) {
+            PJ_CONTEXT *ctx = proj_context_create();
+            PJ *P = proj_create_crs_to_crs(ctx, _crs_from.c_str(), _crs_to.c_str(), NULL);
+
+            if (P == nullptr)
+            {
+                proj_context_destroy(ctx);
+                throw std::runtime_error("Could not create transformation from " + _crs_from + " to " + _crs_to + ".");
+            }
+
+            std::vector<double> x(_batch_size);
+            std::vector<double> y(_batch_size);
+
+            for (size_t offset = begin; offset < end; offset += _batch_size)
+            {
+                size_t count = std::min(_batch_size, end - offset);
+
+                for (size_t j = 0; j < count; j++)
+                {
+                    Coord coord = source(offset + j);
+                    x[j] = coord.lat;
+                    y[j] = coord.lon;
+                }
+
+                proj_trans_generic(P, PJ_FWD,
+                                   x.data(), sizeof(double), count,
+                                   y.data(), sizeof(double), count,
+                                   nullptr, 0, 0,
+                                   nullptr, 0, 0);
+
+                for (size_t j = 0; j < count; j++)
+                {
+                    sink(offset + j, x[j], y[j], thread_id);
+                }
+
+                progress(done += count, n);
+            }
+
+            proj_destroy(P);
+            proj_context_destroy(ctx);
+        }, _batch_size);
+    }
+
+    inline unsigned int n_threads() const
+    {
+        return _n_threads;
+    }
+};
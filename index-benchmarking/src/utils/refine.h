@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Candidate refinement kernels. They test a batch of candidate coordinates (structure-of-arrays) against a query
+// and set bit i of mask[i / 64] for every match. The mask must hold (n + 63) / 64 words; it is overwritten. With
+// AVX2 four candidates are tested per instruction, otherwise a scalar loop is used.
+
+// Number of mask words needed for n candidates.
+inline size_t refine_mask_words(size_t n)
+{
+    return (n + 63) / 64;
+}
+
+// Match points within distance sqrt(distance2) (inclusive) of (qx, qy).
+inline size_t refine_distance(const double *x, const double *y, size_t n, double qx, double qy, double distance2, uint64_t *mask)
+{
+    size_t matches = 0;
+    size_t i = 0;
+
+    for (size_t w = 0; w < refine_mask_words(n); w++)
+    {
+        mask[w] = 0;
+    }
+
+#ifdef __AVX2__
+    const __m256d vqx = _mm256_set1_pd(qx);
+    const __m256d vqy = _mm256_set1_pd(qy);
+    const __m256d vd2 = _mm256_set1_pd(distance2);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), vqx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), vqy);
+        __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+
+        uint64_t bits = (uint64_t)_mm256_movemask_pd(_mm256_cmp_pd(d2, vd2, _CMP_LE_OQ));
+        mask[i / 64] |= bits << (i % 64);
+        matches += __builtin_popcountll(bits);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        double dx = x[i] - qx;
+        double dy = y[i] - qy;
+
+        if (dx * dx + dy * dy <= distance2)
+        {
+            mask[i / 64] |= 1ull << (i % 64);
+            matches++;
+        }
+    }
+
+    return matches;
+}
+
+// Match points inside the (inclusive) box.
+inline size_t refine_range(const double *x, const double *y, size_t n, double min_x, double min_y, double max_x, double max_y, uint64_t *mask)
+{
+    size_t matches = 0;
+    size_t i = 0;
+
+    for (size_t w = 0; w < refine_mask_words(n); w++)
+    {
+        mask[w] = 0;
+    }
+
+#ifdef __AVX2__
+    const __m256d vmin_x = _mm256_set1_pd(min_x);
+    const __m256d vmin_y = _mm256_set1_pd(min_y);
+    const __m256d vmax_x = _mm256_set1_pd(max_x);
+    const __m256d vmax_y = _mm256_set1_pd(max_y);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d vx = _mm256_loadu_pd(x + i);
+        __m256d vy = _mm256_loadu_pd(y + i);
+
+        __m256d in_x = _mm256_and_pd(_mm256_cmp_pd(vx, vmin_x, _CMP_GE_OQ), _mm256_cmp_pd(vx, vmax_x, _CMP_LE_OQ));
+        __m256d in_y = _mm256_and_pd(_mm256_cmp_pd(vy, vmin_y, _CMP_GE_OQ), _mm256_cmp_pd(vy, vmax_y, _CMP_LE_OQ));
+
+        uint64_t bits = (uint64_t)_mm256_movemask_pd(_mm256_and_pd(in_x, in_y));
+        mask[i / 64] |= bits << (i % 64);
+        matches += __builtin_popcountll(bits);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        if (x[i] >= min_x && x[i] <= max_x && y[i] >= min_y && y[i] <= max_y)
+        {
+            mask[i / 64] |= 1ull << (i % 64);
+            matches++;
+        }
+    }
+
+    return matches;
+}
+
+// Call visit(i) for every bit i set in the first n bits of the mask, in increasing order.
+template <typename TVisit>
+inline void for_each_match(const uint64_t *mask, size_t n, TVisit visit)
+{
+    for (size_t w = 0; w < refine_mask_words(n); w++)
+    {
+        uint64_t bits = mask[w];
+
+        while (bits != 0)
+        {
+            visit(w * 64 + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+}
@@ -0,0 +1,254 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include "flat_array.h"
+#include "mmap.h"
+
+// On-disk image of a built index, reloaded by mapping the file and pointing the index arrays into it. Layout:
+//
+//   header   | magic "IDXSNAP" (8 bytes), format version (u32), index version (u32), index kind (16 bytes),
+//            | number of sections (u64)
+//   sections | per section: element size (u64), element count (u64), file offset (u64)
+//   data     | the elements of every section, each starting at a multiple of SNAPSHOT_ALIGNMENT
+//
+// Sections are read back in the order they were written, so an index writes its arrays and values in member order
+// and reads them in its member initializers. Values are stored in host byte order; snapshots are not portable
+// between architectures. An index bumps its own version whenever its layout changes, so stale images are rejected.
+enum
+{
+    SNAPSHOT_FORMAT_VERSION = 1,
+    SNAPSHOT_ALIGNMENT = 64,
+    SNAPSHOT_KIND_LENGTH = 16,
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t format_version;
+    uint32_t index_version;
+    char kind[SNAPSHOT_KIND_LENGTH];
+    uint64_t n_sections;
+};
+
+struct SnapshotSection
+{
+    uint64_t element_size;
+    uint64_t count;
+    uint64_t offset;
+};
+
+static const char SNAPSHOT_MAGIC[8] = "IDXSNAP";
+
+class SnapshotWriter
+{
+private:
+    struct Pending
+    {
+        const char *data;
+        uint64_t element_size;
+        uint64_t count;
+    };
+
+    std::string _kind;
+    uint32_t _version;
+    std::vector<Pending> _sections;
+    std::deque<std::string> _values; // stable storage for values until write()
+
+    static inline uint64_t align(uint64_t offset)
+    {
+        return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+    }
+
+public:
+    SnapshotWriter(std::string kind, uint32_t version) : _kind(kind), _version(version)
+    {
+        if (kind.size() >= SNAPSHOT_KIND_LENGTH)
+        {
+            throw std::runtime_error("Snapshot kind <" + kind + "> is too long.");
+        }
+    }
+
+    // The array is referenced, not copied, so it must outlive the call to write().
+    template <typename T>
+    void array(const FlatArray<T> &values)
+    {
+        _sections.push_back({reinterpret_cast<const char *>(values.data()), sizeof(T), values.size()});
+    }
+
+    template <typename T>
+    void value(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Snapshot values are stored as raw bytes.");
+
+        _values.emplace_back(reinterpret_cast<const char *>(&value), sizeof(T));
+        _sections.push_back({_values.back().data(), sizeof(T), 1});
+    }
+
+    // Write the image to file_path and return its size in bytes.
+    size_t write(std::string file_path) const
+    {
+        SnapshotHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.format_version = SNAPSHOT_FORMAT_VERSION;
+        header.index_version = _version;
+        std::memcpy(header.kind, _kind.data(), _kind.size());
+        header.n_sections = _sections.size();
+
+        std::vector<SnapshotSection> table;
+        uint64_t offset = align(sizeof(SnapshotHeader) + _sections.size() * sizeof(SnapshotSection));
+
+        for (const auto &section : _sections)
+        {
+            table.push_back({section.element_size, section.count, offset});
+            offset = align(offset + section.element_size * section.count);
+        }
+
+        std::ofstream out(file_path, std::ios::binary | std::ios::trunc);
+
+        if (!out)
+        {
+            throw std::runtime_error("Could not open <" + file_path + "> for writing.");
+        }
+
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(SnapshotSection));
+
+        const char padding[SNAPSHOT_ALIGNMENT] = {};
+        uint64_t position = sizeof(SnapshotHeader) + table.size() * sizeof(SnapshotSection);
+
+        for (size_t s = 0; s < _sections.size(); s++)
+        {
+            out.write(padding, table[s].offset - position);
+            out.write(_sections[s].data, _sections[s].element_size * _sections[s].count);
+            position = table[s].offset + _sections[s].element_size * _sections[s].count;
+        }
+
+        out.write(padding, offset - position);
+        out.close();
+
+        if (!out)
+        {
+            throw std::runtime_error("Could not write <" + file_path + ">.");
+        }
+
+        return offset;
+    }
+};
+
+// Maps a snapshot and hands out its sections in order. Arrays are views into the mapping, which stays alive for as
+// long as any of them does; nothing is copied or allocated per element.
+class SnapshotReader
+{
+private:
+    std::string _file_path;
+    std::shared_ptr<MappedFile> _file;
+    const SnapshotSection *_sections;
+    size_t _n_sections;
+    size_t _next;
+
+    const SnapshotSection &next(size_t element_size)
+    {
+        if (_next >= _n_sections)
+        {
+            throw std::runtime_error("Snapshot <" + _file_path + "> has fewer sections than expected.");
+        }
+
+        const auto &section = _sections[_next++];
+
+        if (section.element_size != element_size)
+        {
+            throw std::runtime_error("Snapshot <" + _file_path + "> has a section of unexpected element size.");
+        }
+
+        return section;
+    }
+
+public:
+    SnapshotReader(std::string file_path, std::string kind, uint32_t version) : _file_path(file_path), _file(std::make_shared<MappedFile>(file_path)), _next(0)
+    {
+        if (_file->size() < sizeof(SnapshotHeader))
+        {
+            throw std::runtime_error("Snapshot <" + file_path + "> is truncated.");
+        }
+
+        SnapshotHeader header;
+        std::memcpy(&header, _file->data(), sizeof(header));
+
+        if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.format_version != SNAPSHOT_FORMAT_VERSION)
+        {
+            throw std::runtime_error("<" + file_path + "> is not a snapshot of format version " + std::to_string(SNAPSHOT_FORMAT_VERSION) + ".");
+        }
+
+        if (std::string(header.kind, strnlen(header.kind, SNAPSHOT_KIND_LENGTH)) != kind || header.index_version != version)
+        {
+            throw std::runtime_error("Snapshot <" + file_path + "> does not hold a " + kind + " of version " + std::to_string(version) + ".");
+        }
+
+        _n_sections = header.n_sections;
+
+        if (_n_sections > (_file->size() - sizeof(SnapshotHeader)) / sizeof(SnapshotSection))
+        {
+            throw std::runtime_error("Snapshot <" + file_path + "> is truncated.");
+        }
+
+        _sections = reinterpret_cast<const SnapshotSection *>(_file->data() + sizeof(SnapshotHeader));
+
+        for (size_t s = 0; s < _n_sections; s++)
+        {
+            const auto &section = _sections[s];
+
+            if (section.offset % SNAPSHOT_ALIGNMENT != 0 || section.offset > _file->size() || (section.element_size > 0 && section.count > (_file->size() - section.offset) / section.element_size))
+            {
+                throw std::runtime_error("Snapshot <" + file_path + "> is truncated.");
+            }
+        }
+    }
+
+    template <typename T>
+    FlatArray<T> array()
+    {
+        const auto &section = next(sizeof(T));
+        return FlatArray<T>(reinterpret_cast<const T *>(_file->data() + section.offset), section.count, _file);
+    }
+
+    template <typename T>
+    T value()
+    {
+        const auto &section = next(sizeof(T));
+
+        if (section.count != 1)
+        {
+            throw std::runtime_error("Snapshot <" + _file_path + "> has an array where a value was expected.");
+        }
+
+        T value;
+        std::memcpy(&value, _file->data() + section.offset, sizeof(T));
+        return value;
+    }
+};
+
+// Write index to a snapshot at file_path and return its size in bytes. TIndex provides snapshot_kind(),
+// SNAPSHOT_VERSION and save(SnapshotWriter &).
+template <typename TIndex>
+size_t save_snapshot(const TIndex &index, std::string file_path)
+{
+    SnapshotWriter writer(TIndex::snapshot_kind(), TIndex::SNAPSHOT_VERSION);
+    index.save(writer);
+    return writer.write(file_path);
+}
+
+// Map the snapshot at file_path back into an index. TIndex provides a constructor from SnapshotReader &.
+template <typename TIndex>
+std::unique_ptr<TIndex> load_snapshot(std::string file_path)
+{
+    SnapshotReader reader(file_path, TIndex::snapshot_kind(), TIndex::SNAPSHOT_VERSION);
+    return std::make_unique<TIndex>(reader);
+}
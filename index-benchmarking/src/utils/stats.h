@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <numeric>
+
+// Mean of the samples, 0 if there are none.
+inline double sample_mean(const std::vector<double> &samples)
+{
+    return samples.empty() ? 0 : std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+// Sample standard deviation (n - 1 in the denominator), 0 for fewer than two samples.
+inline double sample_stddev(const std::vector<double> &samples)
+{
+    if (samples.size() < 2)
+    {
+        return 0;
+    }
+
+    double mean = sample_mean(samples);
+    double sum = 0;
+
+    for (auto sample : samples)
+    {
+        sum += (sample - mean) * (sample - mean);
+    }
+
+    return std::sqrt(sum / (samples.size() - 1));
+}
+
+// Two-sided 95% quantile of Student's t distribution with the given degrees of freedom.
+inline double student_t95(size_t degrees_of_freedom)
+{
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+    if (degrees_of_freedom == 0)
+    {
+        return 0;
+    }
+
+    return degrees_of_freedom <= 30 ? table[degrees_of_freedom - 1] : 1.960;
+}
+
+// Half-width of the 95% confidence interval of the mean, 0 for fewer than two samples.
+inline double ci95_half_width(const std::vector<double> &samples)
+{
+    if (samples.size() < 2)
+    {
+        return 0;
+    }
+
+    return student_t95(samples.size() - 1) * sample_stddev(samples) / std::sqrt((double)samples.size());
+}
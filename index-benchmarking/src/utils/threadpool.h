@@ -0,0 +1,190 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include "parallel.h"
+
+// Fixed set of worker threads for short tasks that are too fine-grained to start threads for, such as the per-shard
+// work of a single query. Unlike parallel_for, the threads live as long as the pool.
+class ThreadPool
+{
+private:
+    std::vector<std::thread> _workers;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _available;
+    bool _stopping = false;
+
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _available.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+
+                if (_tasks.empty())
+                {
+                    return;
+                }
+
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    bool try_run_one()
+    {
+        std::function<void()> task;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (_tasks.empty())
+            {
+                return false;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+
+        task();
+        return true;
+    }
+
+public:
+    // The calling thread of run() takes part in the work, so n_threads - 1 workers are started.
+    ThreadPool(unsigned int n_threads = hardware_threads())
+    {
+        for (unsigned int t = 1; t < n_threads; t++)
+        {
+            _workers.emplace_back(&ThreadPool::work, this);
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+
+        _available.notify_all();
+
+        for (auto &worker : _workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    inline unsigned int n_threads() const
+    {
+        return _workers.size() + 1;
+    }
+
+    // Call fn(i) for every i in [0, n) and return once all calls finished. The caller runs tasks of the pool while
+    // it waits, so run() may be called from several threads at once, or from within a task, without deadlocking.
+    // The first exception thrown by fn is rethrown on the calling thread.
+    template <typename F>
+    void run(size_t n, F fn)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+
+        if (n == 1 || _workers.empty())
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                fn(i);
+            }
+
+            return;
+        }
+
+        // Guarded by done_mutex. The last task signals while holding it, so the state below outlives every access.
+        std::mutex done_mutex;
+        std::condition_variable done;
+        size_t remaining = n;
+        std::exception_ptr error;
+
+        auto task = [&](size_t i) {
+            std::exception_ptr task_error;
+
+            try
+            {
+                fn(i);
+            }
+            catch (...)
+            {
+                task_error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(done_mutex);
+
+            if (task_error && !error)
+            {
+                error = task_error;
+            }
+
+            if (--remaining == 0)
+            {
+                done.notify_all();
+            }
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            for (size_t i = 1; i < n; i++)
+            {
+                _tasks.emplace_back([&task, i]() { task(i); });
+            }
+        }
+
+        for (size_t i = 1; i < n && i <= _workers.size(); i++)
+        {
+            _available.notify_one();
+        }
+
+        task(0);
+
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(done_mutex);
+
+                if (remaining == 0)
+                {
+                    break;
+                }
+            }
+
+            if (!try_run_one())
+            {
+                std::unique_lock<std::mutex> lock(done_mutex);
+                done.wait(lock, [&remaining]() { return remaining == 0; });
+                break;
+            }
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+};
@@ -0,0 +1,93 @@
+"""
+convert_queries.py
+
+Convert CSV query files (*_distance_*.csv, *_range_*.csv, *_knn*.csv) into the binary
+query format read by index-benchmarking (see QueryFileHeader in src/utils/data.h). The binary file
+is written next to the CSV with a .qbin extension, where the benchmarks pick it up automatically.
+
+Usage: python convert_queries.py data/taxi data/synthetic
+"""
+
+import re
+import sys
+import struct
+from array import array
+from pathlib import Path
+
+MAGIC = b'QRYB'
+VERSION = 2
+DISTANCE_QUERY = 0
+RANGE_QUERY = 1
+KNN_QUERY = 2
+CRS = 4326
+
+# magic, version, type, crs, count, selectivity
+HEADER_FORMAT = '<4sIIIQd'
+
+
+def _selectivity_from_name(path):
+    # File names hold the selectivity in percent, the header stores a fraction.
+    match = re.search(r'_([0-9.]+)$', path.stem)
+    return float(match.group(1)) / 100 if match else float('nan')
+
+
+def _file_version(path):
+    with path.open('rb') as f:
+        header = f.read(struct.calcsize(HEADER_FORMAT))
+
+    if len(header) != struct.calcsize(HEADER_FORMAT):
+        return None
+
+    magic, version = struct.unpack(HEADER_FORMAT, header)[:2]
+    return version if magic == MAGIC else None
+
+
+def convert(csv_file, query_type, n_columns):
+    target_file = csv_file.with_suffix('.qbin')
+
+    # Files of an older version are rebuilt even if they are newer than the CSV.
+    if target_file.exists() and target_file.stat().st_mtime >= csv_file.stat().st_mtime and _file_version(target_file) == VERSION:
+        print(f'File <{target_file}> is up to date, skipping...')
+        return
+
+    print(f'Converting <{csv_file}>...')
+    records = array('d')
+    count = 0
+
+    with csv_file.open() as f:
+        for line in f:
+            values = line.strip().split(',')
+            if values == ['']:
+                continue
+
+            if len(values) != n_columns:
+                raise ValueError(f'<{csv_file}> has {len(values)} columns, expected {n_columns}.')
+
+            records.extend(float(v) for v in values)
+            count += 1
+
+    if sys.byteorder != 'little':
+        records.byteswap()
+
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, query_type, CRS, count, _selectivity_from_name(csv_file))
+
+    with open(target_file, 'wb') as f:
+        f.write(header)
+        records.tofile(f)
+
+def convert_folder(folder):
+    for csv_file in sorted(folder.rglob('*_distance_*.csv')):
+        convert(csv_file, DISTANCE_QUERY, 3)
+
+    for csv_file in sorted(folder.rglob('*_range_*.csv')):
+        convert(csv_file, RANGE_QUERY, 4)
+
+    for csv_file in sorted(folder.rglob('*_knn*.csv')):
+        convert(csv_file, KNN_QUERY, 2)
+
+
+if __name__ == '__main__':
+    folders = [Path(arg) for arg in sys.argv[1:]] or [Path('data/taxi'), Path('data/synthetic')]
+
+    for folder in folders:
+        convert_folder(folder)